@@ -83,19 +83,119 @@ namespace firi
         }
     }
 
+    /* Iteration buffers of firi (Dim 3) and firi2d (Dim 2) for m
+       halfspaces of the box and n points, grown like the ones below.
+       The polytope of the last iteration is left in the first nH rows
+       of hPoly. */
+    template <int Dim>
+    struct FIRIBuffers
+    {
+        int nH;
+        Eigen::Matrix<double, -1, Dim> forwardB;
+        Eigen::Matrix<double, Dim, -1> forwardPC;
+        Eigen::VectorXd forwardD, distDs, distRs;
+        Eigen::Matrix<double, -1, Dim + 1> tangents, forwardH, hPoly;
+        Eigen::Matrix<uint8_t, -1, 1> bdFlags, pcFlags;
+
+        FIRIBuffers() : nH(0) {}
+
+        inline void reserve(const int m, const int n)
+        {
+            if (forwardB.rows() < m)
+            {
+                forwardB.resize(m, Dim);
+                forwardD.resize(m);
+                distDs.resize(m);
+                bdFlags.resize(m);
+            }
+            if (forwardPC.cols() < n)
+            {
+                forwardPC.resize(Dim, n);
+                distRs.resize(n);
+                tangents.resize(n, Dim + 1);
+                pcFlags.resize(n);
+            }
+            if (forwardH.rows() < m + n)
+            {
+                forwardH.resize(m + n, Dim + 1);
+                hPoly.resize(m + n, Dim + 1);
+            }
+        }
+
+        inline Eigen::Block<Eigen::Matrix<double, -1, Dim + 1>> result()
+        {
+            return hPoly.block(0, 0, nH, Dim + 1);
+        }
+    };
+
+    /* Buffers of maxVolInsEllipsoid / maxVolInsEllipse and of the MVIE
+       cost they minimize. They only grow, so once a workspace has seen
+       the largest number of halfspaces, solving allocates nothing more
+       for them. Keep one per thread, it is not safe to share. Workers
+       that come and go should be handed one that outlives them (see
+       convexCover). */
+    struct MVIEWorkspace
+    {
+        int M;
+        double smoothEps;
+        double penaltyWt;
+
+        /* views into the arena, valid until the next reserve */
+        double *Alp, *blp, *hNorm, *depth;
+        double *A, *AL, *normAL, *adjNormAL, *consViola;
+
+        /* variables and L-BFGS buffers of ellipses [0] and ellipsoids [1]
+           apart, so solving both in one workspace doesn't resize them */
+        Eigen::VectorXd x[2];
+        lbfgs::lbfgs_workspace_t lbfgs[2];
+        sdlp::LPWorkspace lp;
+        std::vector<double> arena;
+
+        /* of firi2d and firi */
+        FIRIBuffers<2> iter2;
+        FIRIBuffers<3> iter3;
+
+        /* make room for M halfspaces in dim dimensions */
+        inline void reserve(const int m, const int dim)
+        {
+            const size_t need = (size_t)m * (4 * dim + 6);
+            if (arena.size() < need)
+            {
+                arena.resize(need);
+            }
+
+            M = m;
+            Alp = arena.data();
+            blp = Alp + m * (dim + 1);
+            hNorm = blp + m;
+            depth = hNorm + m;
+            A = depth + m;
+            AL = A + m * dim;
+            normAL = AL + m * dim;
+            adjNormAL = normAL + m;
+            consViola = adjNormAL + m * dim;
+
+            x[dim - 2].resize(2 * dim + dim * (dim - 1) / 2);
+        }
+    };
+
+    /* workspace of the calls that don't bring their own, one per thread */
+    inline MVIEWorkspace &default_workspace()
+    {
+        static thread_local MVIEWorkspace ws;
+        return ws;
+    }
+
     inline double costMVIE(void *data,
                            const Eigen::VectorXd &x,
                            Eigen::VectorXd &grad)
     {
-        const int *pM = (int *)data;
-        const double *pSmoothEps = (double *)(pM + 1);
-        const double *pPenaltyWt = pSmoothEps + 1;
-        const double *pA = pPenaltyWt + 1;
-
-        const int M = *pM;
-        const double smoothEps = *pSmoothEps;
-        const double penaltyWt = *pPenaltyWt;
-        Eigen::Map<const Eigen::MatrixX3d> A(pA, M, 3);
+        const MVIEWorkspace &ws = *(const MVIEWorkspace *)data;
+
+        const int M = ws.M;
+        const double smoothEps = ws.smoothEps;
+        const double penaltyWt = ws.penaltyWt;
+        Eigen::Map<const Eigen::MatrixX3d> A(ws.A, M, 3);
         Eigen::Map<const Eigen::Vector3d> p(x.data());
         Eigen::Map<const Eigen::Vector3d> rtd(x.data() + 3);
         Eigen::Map<const Eigen::Vector3d> cde(x.data() + 6);
@@ -119,10 +219,16 @@ namespace firi
         L(2, 1) = cde(1);
         L(2, 2) = rtd(2) * rtd(2) + DBL_EPSILON;
 
-        const Eigen::MatrixX3d AL = A * L;
-        const Eigen::VectorXd normAL = AL.rowwise().norm();
-        const Eigen::Matrix3Xd adjNormAL = (AL.array().colwise() / normAL.array()).transpose();
-        const Eigen::VectorXd consViola = (normAL + A * p).array() - 1.0;
+        Eigen::Map<Eigen::MatrixX3d> AL(ws.AL, M, 3);
+        Eigen::Map<Eigen::VectorXd> normAL(ws.normAL, M);
+        Eigen::Map<Eigen::Matrix3Xd> adjNormAL(ws.adjNormAL, 3, M);
+        Eigen::Map<Eigen::VectorXd> consViola(ws.consViola, M);
+        AL.noalias() = A * L;
+        normAL = AL.rowwise().norm();
+        adjNormAL = (AL.array().colwise() / normAL.array()).transpose();
+        consViola.noalias() = A * p;
+        consViola += normAL;
+        consViola.array() -= 1.0;
 
         double c, dc;
         Eigen::Vector3d vec;
@@ -160,23 +266,27 @@ namespace firi
     // h0*x + h1*y + h2*z + h3 <= 0
     // R, p, r are ALWAYS taken as the initial guess
     // R is also assumed to be a rotation matrix
-    inline bool maxVolInsEllipsoid(const Eigen::MatrixX4d &hPoly,
+    // ws holds all the buffers of the call (see MVIEWorkspace)
+    inline bool maxVolInsEllipsoid(const Eigen::Ref<const Eigen::MatrixX4d> &hPoly,
                                    Eigen::Matrix3d &R,
                                    Eigen::Vector3d &p,
-                                   Eigen::Vector3d &r)
+                                   Eigen::Vector3d &r,
+                                   MVIEWorkspace &ws)
     {
         // Find the deepest interior point
         const int M = hPoly.rows();
-        Eigen::MatrixX4d Alp(M, 4);
-        Eigen::VectorXd blp(M);
+        ws.reserve(M, 3);
+        Eigen::Map<Eigen::MatrixX4d> Alp(ws.Alp, M, 4);
+        Eigen::Map<Eigen::VectorXd> blp(ws.blp, M);
+        Eigen::Map<Eigen::VectorXd> hNorm(ws.hNorm, M);
         Eigen::Vector4d clp, xlp;
-        const Eigen::ArrayXd hNorm = hPoly.leftCols<3>().rowwise().norm();
-        Alp.leftCols<3>() = hPoly.leftCols<3>().array().colwise() / hNorm;
+        hNorm = hPoly.leftCols<3>().rowwise().norm();
+        Alp.leftCols<3>() = hPoly.leftCols<3>().array().colwise() / hNorm.array();
         Alp.rightCols<1>().setConstant(1.0);
-        blp = -hPoly.rightCols<1>().array() / hNorm;
+        blp = -hPoly.rightCols<1>().array() / hNorm.array();
         clp.setZero();
         clp(3) = -1.0;
-        const double maxdepth = -sdlp::linprog<4>(clp, Alp, blp, xlp);
+        const double maxdepth = -sdlp::linprog<4>(clp, Alp, blp, xlp, ws.lp);
         if (!(maxdepth > 0.0) || std::isinf(maxdepth))
         {
             return false;
@@ -184,18 +294,13 @@ namespace firi
         const Eigen::Vector3d interior = xlp.head<3>();
 
         // Prepare the data for MVIE optimization
-        uint8_t *optData = new uint8_t[sizeof(int) + (2 + 3 * M) * sizeof(double)];
-        int *pM = (int *)optData;
-        double *pSmoothEps = (double *)(pM + 1);
-        double *pPenaltyWt = pSmoothEps + 1;
-        double *pA = pPenaltyWt + 1;
-
-        *pM = M;
-        Eigen::Map<Eigen::MatrixX3d> A(pA, M, 3);
-        A = Alp.leftCols<3>().array().colwise() /
-            (blp - Alp.leftCols<3>() * interior).array();
-
-        Eigen::VectorXd x(9);
+        Eigen::Map<Eigen::VectorXd> depth(ws.depth, M);
+        Eigen::Map<Eigen::MatrixX3d> A(ws.A, M, 3);
+        depth.noalias() = Alp.leftCols<3>() * interior;
+        depth = blp - depth;
+        A = Alp.leftCols<3>().array().colwise() / depth.array();
+
+        Eigen::VectorXd &x = ws.x[1];
         const Eigen::Matrix3d Q = R * (r.cwiseProduct(r)).asDiagonal() * R.transpose();
         Eigen::Matrix3d L;
         chol3d(Q, L);
@@ -215,22 +320,22 @@ namespace firi
         paramsMVIE.min_step = 1.0e-32;
         paramsMVIE.past = 3;
         paramsMVIE.delta = 1.0e-7;
-        *pSmoothEps = 1.0e-2;
-        *pPenaltyWt = 1.0e+3;
+        ws.smoothEps = 1.0e-2;
+        ws.penaltyWt = 1.0e+3;
 
         int ret = lbfgs::lbfgs_optimize(x,
                                         minCost,
                                         &costMVIE,
                                         nullptr,
                                         nullptr,
-                                        optData,
-                                        paramsMVIE);
+                                        &ws,
+                                        paramsMVIE,
+                                        &ws.lbfgs[1]);
 
         if (ret < 0)
         {
             printf("FIRI WARNING: %s\n", lbfgs::lbfgs_strerror(ret));
             
-            delete[] optData;
             return false;
         }
 
@@ -262,24 +367,31 @@ namespace firi
             r = S;
         }
 
-        delete[] optData;
-
         return ret >= 0;
     }
 
-    inline bool firi(const Eigen::MatrixX4d &bd,
-                     const Eigen::Matrix3Xd &pc,
+    inline bool maxVolInsEllipsoid(const Eigen::Ref<const Eigen::MatrixX4d> &hPoly,
+                                   Eigen::Matrix3d &R,
+                                   Eigen::Vector3d &p,
+                                   Eigen::Vector3d &r)
+    {
+        return maxVolInsEllipsoid(hPoly, R, p, r, default_workspace());
+    }
+
+    inline bool firi(const Eigen::Ref<const Eigen::MatrixX4d> &bd,
+                     const Eigen::Ref<const Eigen::Matrix3Xd> &pc,
                      const Eigen::Vector3d &a,
                      const Eigen::Vector3d &b,
                      Eigen::MatrixX4d &hPoly,
+                     MVIEWorkspace &ws,
                      const int iterations = 4,
                      const double epsilon = 1.0e-6)
     {
         const Eigen::Vector4d ah(a(0), a(1), a(2), 1.0);
         const Eigen::Vector4d bh(b(0), b(1), b(2), 1.0);
 
-        if ((bd * ah).maxCoeff() > 0.0 ||
-            (bd * bh).maxCoeff() > 0.0)
+        if (bd.lazyProduct(ah).maxCoeff() > 0.0 ||
+            bd.lazyProduct(bh).maxCoeff() > 0.0)
         {
             return false;
         }
@@ -290,22 +402,32 @@ namespace firi
         Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
         Eigen::Vector3d p = 0.5 * (a + b);
         Eigen::Vector3d r = Eigen::Vector3d::Ones();
-        Eigen::MatrixX4d forwardH(M + N, 4);
-        int nH = 0;
+        FIRIBuffers<3> &buf = ws.iter3;
+        buf.reserve(M, N);
+        Eigen::MatrixX4d &forwardH = buf.forwardH;
+        int &nH = buf.nH;
+        nH = 0;
 
         for (int loop = 0; loop < iterations; ++loop)
         {
             const Eigen::Matrix3d forward = r.cwiseInverse().asDiagonal() * R.transpose();
             const Eigen::Matrix3d backward = R * r.asDiagonal();
-            const Eigen::MatrixX3d forwardB = bd.leftCols<3>() * backward;
-            const Eigen::VectorXd forwardD = bd.rightCols<1>() + bd.leftCols<3>() * p;
-            const Eigen::Matrix3Xd forwardPC = forward * (pc.colwise() - p);
+            auto forwardB = buf.forwardB.topRows(M);
+            auto forwardD = buf.forwardD.head(M);
+            auto forwardPC = buf.forwardPC.leftCols(N);
+            forwardB.noalias() = bd.leftCols<3>().lazyProduct(backward);
+            forwardD = bd.rightCols<1>() + bd.leftCols<3>().lazyProduct(p);
+            for (int i = 0; i < N; i++)
+            {
+                forwardPC.col(i) = forward * (pc.col(i) - p);
+            }
             const Eigen::Vector3d fwd_a = forward * (a - p);
             const Eigen::Vector3d fwd_b = forward * (b - p);
 
-            const Eigen::VectorXd distDs = forwardD.cwiseAbs().cwiseQuotient(forwardB.rowwise().norm());
-            Eigen::MatrixX4d tangents(N, 4);
-            Eigen::VectorXd distRs(N);
+            auto distDs = buf.distDs.head(M);
+            auto distRs = buf.distRs.head(N);
+            auto tangents = buf.tangents.topRows(N);
+            distDs = forwardD.cwiseAbs().cwiseQuotient(forwardB.rowwise().norm());
 
             for (int i = 0; i < N; i++)
             {
@@ -336,8 +458,10 @@ namespace firi
                 }
             }
 
-            Eigen::Matrix<uint8_t, -1, 1> bdFlags = Eigen::Matrix<uint8_t, -1, 1>::Constant(M, 1);
-            Eigen::Matrix<uint8_t, -1, 1> pcFlags = Eigen::Matrix<uint8_t, -1, 1>::Constant(N, 1);
+            auto bdFlags = buf.bdFlags.head(M);
+            auto pcFlags = buf.pcFlags.head(N);
+            bdFlags.setOnes();
+            pcFlags.setOnes();
 
             nH = 0;
 
@@ -400,11 +524,10 @@ namespace firi
                 ++nH;
             }
 
-            hPoly.resize(nH, 4);
             for (int i = 0; i < nH; ++i)
             {
-                hPoly.block<1, 3>(i, 0) = forwardH.block<1, 3>(i, 0) * forward;
-                hPoly(i, 3) = forwardH(i, 3) - hPoly.block<1, 3>(i, 0).dot(p);
+                buf.hPoly.block<1, 3>(i, 0) = forwardH.block<1, 3>(i, 0) * forward;
+                buf.hPoly(i, 3) = forwardH(i, 3) - buf.hPoly.block<1, 3>(i, 0).dot(p);
             }
 
             if (loop == iterations - 1)
@@ -413,13 +536,416 @@ namespace firi
             }
 
             // Nick: Added if statement here
-            if (!maxVolInsEllipsoid(hPoly, R, p, r))
+            if (!maxVolInsEllipsoid(buf.result(), R, p, r, ws))
                 return false;
         }
 
+        hPoly = buf.result();
+
         return true;
     }
 
+    inline bool firi(const Eigen::Ref<const Eigen::MatrixX4d> &bd,
+                     const Eigen::Ref<const Eigen::Matrix3Xd> &pc,
+                     const Eigen::Vector3d &a,
+                     const Eigen::Vector3d &b,
+                     Eigen::MatrixX4d &hPoly,
+                     const int iterations = 4,
+                     const double epsilon = 1.0e-6)
+    {
+        return firi(bd, pc, a, b, hPoly, default_workspace(), iterations, epsilon);
+    }
+
+    /* Planar version of the above for ground robots: the polytopes are
+       polygons in the xy plane, the ellipsoid an ellipse, and the LP for
+       the deepest interior point has 3 variables instead of 4 */
+
+    inline void chol2d(const Eigen::Matrix2d &A,
+                       Eigen::Matrix2d &L)
+    {
+        L(0, 0) = sqrt(A(0, 0));
+        L(0, 1) = 0.0;
+        L(1, 0) = 0.5 * (A(0, 1) + A(1, 0)) / L(0, 0);
+        L(1, 1) = sqrt(A(1, 1) - L(1, 0) * L(1, 0));
+        return;
+    }
+
+    inline double costMVIE2d(void *data,
+                             const Eigen::VectorXd &x,
+                             Eigen::VectorXd &grad)
+    {
+        const MVIEWorkspace &ws = *(const MVIEWorkspace *)data;
+
+        const int M = ws.M;
+        const double smoothEps = ws.smoothEps;
+        const double penaltyWt = ws.penaltyWt;
+        Eigen::Map<const Eigen::MatrixX2d> A(ws.A, M, 2);
+        Eigen::Map<const Eigen::Vector2d> p(x.data());
+        Eigen::Map<const Eigen::Vector2d> rtd(x.data() + 2);
+        const double cde = x(4);
+        Eigen::Map<Eigen::Vector2d> gdp(grad.data());
+        Eigen::Map<Eigen::Vector2d> gdrtd(grad.data() + 2);
+        double &gdcde = grad(4);
+
+        double cost = 0;
+        gdp.setZero();
+        gdrtd.setZero();
+        gdcde = 0.0;
+
+        Eigen::Matrix2d L;
+        L(0, 0) = rtd(0) * rtd(0) + DBL_EPSILON;
+        L(0, 1) = 0.0;
+        L(1, 0) = cde;
+        L(1, 1) = rtd(1) * rtd(1) + DBL_EPSILON;
+
+        Eigen::Map<Eigen::MatrixX2d> AL(ws.AL, M, 2);
+        Eigen::Map<Eigen::VectorXd> normAL(ws.normAL, M);
+        Eigen::Map<Eigen::Matrix2Xd> adjNormAL(ws.adjNormAL, 2, M);
+        Eigen::Map<Eigen::VectorXd> consViola(ws.consViola, M);
+        AL.noalias() = A * L;
+        normAL = AL.rowwise().norm();
+        adjNormAL = (AL.array().colwise() / normAL.array()).transpose();
+        consViola.noalias() = A * p;
+        consViola += normAL;
+        consViola.array() -= 1.0;
+
+        double c, dc;
+        Eigen::Vector2d vec;
+        for (int i = 0; i < M; ++i)
+        {
+            if (smoothedL1(smoothEps, consViola(i), c, dc))
+            {
+                cost += c;
+                vec = dc * A.row(i).transpose();
+                gdp += vec;
+                gdrtd += adjNormAL.col(i).cwiseProduct(vec);
+                gdcde += adjNormAL(0, i) * vec(1);
+            }
+        }
+        cost *= penaltyWt;
+        gdp *= penaltyWt;
+        gdrtd *= penaltyWt;
+        gdcde *= penaltyWt;
+
+        cost -= log(L(0, 0)) + log(L(1, 1));
+        gdrtd(0) -= 1.0 / L(0, 0);
+        gdrtd(1) -= 1.0 / L(1, 1);
+
+        gdrtd(0) *= 2.0 * rtd(0);
+        gdrtd(1) *= 2.0 * rtd(1);
+
+        return cost;
+    }
+
+    // Each row of hPoly is defined by h0, h1, h2 as
+    // h0*x + h1*y + h2 <= 0
+    // R, p, r are ALWAYS taken as the initial guess
+    // R is also assumed to be a rotation matrix
+    inline bool maxVolInsEllipse(const Eigen::Ref<const Eigen::MatrixX3d> &hPoly,
+                                 Eigen::Matrix2d &R,
+                                 Eigen::Vector2d &p,
+                                 Eigen::Vector2d &r,
+                                 MVIEWorkspace &ws)
+    {
+        // Find the deepest interior point
+        const int M = hPoly.rows();
+        ws.reserve(M, 2);
+        Eigen::Map<Eigen::MatrixX3d> Alp(ws.Alp, M, 3);
+        Eigen::Map<Eigen::VectorXd> blp(ws.blp, M);
+        Eigen::Map<Eigen::VectorXd> hNorm(ws.hNorm, M);
+        Eigen::Vector3d clp, xlp;
+        hNorm = hPoly.leftCols<2>().rowwise().norm();
+        Alp.leftCols<2>() = hPoly.leftCols<2>().array().colwise() / hNorm.array();
+        Alp.rightCols<1>().setConstant(1.0);
+        blp = -hPoly.rightCols<1>().array() / hNorm.array();
+        clp.setZero();
+        clp(2) = -1.0;
+        const double maxdepth = -sdlp::linprog<3>(clp, Alp, blp, xlp, ws.lp);
+        if (!(maxdepth > 0.0) || std::isinf(maxdepth))
+        {
+            return false;
+        }
+        const Eigen::Vector2d interior = xlp.head<2>();
+
+        // Prepare the data for MVIE optimization
+        Eigen::Map<Eigen::VectorXd> depth(ws.depth, M);
+        Eigen::Map<Eigen::MatrixX2d> A(ws.A, M, 2);
+        depth.noalias() = Alp.leftCols<2>() * interior;
+        depth = blp - depth;
+        A = Alp.leftCols<2>().array().colwise() / depth.array();
+
+        Eigen::VectorXd &x = ws.x[0];
+        const Eigen::Matrix2d Q = R * (r.cwiseProduct(r)).asDiagonal() * R.transpose();
+        Eigen::Matrix2d L;
+        chol2d(Q, L);
+
+        x.head<2>() = p - interior;
+        x(2) = sqrt(L(0, 0));
+        x(3) = sqrt(L(1, 1));
+        x(4) = L(1, 0);
+
+        double minCost;
+        lbfgs::lbfgs_parameter_t paramsMVIE;
+        paramsMVIE.mem_size = 18;
+        paramsMVIE.g_epsilon = 0.0;
+        paramsMVIE.min_step = 1.0e-32;
+        paramsMVIE.past = 3;
+        paramsMVIE.delta = 1.0e-7;
+        ws.smoothEps = 1.0e-2;
+        ws.penaltyWt = 1.0e+3;
+
+        int ret = lbfgs::lbfgs_optimize(x,
+                                        minCost,
+                                        &costMVIE2d,
+                                        nullptr,
+                                        nullptr,
+                                        &ws,
+                                        paramsMVIE,
+                                        &ws.lbfgs[0]);
+
+        // Started from the ellipse of the last iteration, the search is
+        // often at the optimum already and the line search can't make
+        // any progress. x is the last accepted iterate then, keep it.
+        if (ret == lbfgs::LBFGSERR_MAXIMUMLINESEARCH)
+        {
+            ret = 0;
+        }
+
+        if (ret < 0)
+        {
+            printf("FIRI WARNING: %s\n", lbfgs::lbfgs_strerror(ret));
+
+            return false;
+        }
+
+        p = x.head<2>() + interior;
+        L(0, 0) = x(2) * x(2);
+        L(0, 1) = 0.0;
+        L(1, 0) = x(4);
+        L(1, 1) = x(3) * x(3);
+        Eigen::JacobiSVD<Eigen::Matrix2d> svd(L, Eigen::ComputeFullU);
+        const Eigen::Matrix2d U = svd.matrixU();
+        const Eigen::Vector2d S = svd.singularValues();
+        if (U.determinant() < 0.0)
+        {
+            R.col(0) = U.col(1);
+            R.col(1) = U.col(0);
+            r(0) = S(1);
+            r(1) = S(0);
+        }
+        else
+        {
+            R = U;
+            r = S;
+        }
+
+        return ret >= 0;
+    }
+
+    inline bool maxVolInsEllipse(const Eigen::Ref<const Eigen::MatrixX3d> &hPoly,
+                                 Eigen::Matrix2d &R,
+                                 Eigen::Vector2d &p,
+                                 Eigen::Vector2d &r)
+    {
+        return maxVolInsEllipse(hPoly, R, p, r, default_workspace());
+    }
+
+    /* The polygon is left in ws.iter2.result(), valid until the next
+       call in ws. Copying it out costs an allocation whenever its size
+       changes, callers that keep their own storage can skip that. */
+    inline bool firi2d(const Eigen::Ref<const Eigen::MatrixX3d> &bd,
+                       const Eigen::Ref<const Eigen::Matrix2Xd> &pc,
+                       const Eigen::Vector2d &a,
+                       const Eigen::Vector2d &b,
+                       MVIEWorkspace &ws,
+                       const int iterations = 4,
+                       const double epsilon = 1.0e-6)
+    {
+        const Eigen::Vector3d ah(a(0), a(1), 1.0);
+        const Eigen::Vector3d bh(b(0), b(1), 1.0);
+
+        if (bd.lazyProduct(ah).maxCoeff() > 0.0 ||
+            bd.lazyProduct(bh).maxCoeff() > 0.0)
+        {
+            return false;
+        }
+
+        const int M = bd.rows();
+        const int N = pc.cols();
+
+        Eigen::Matrix2d R = Eigen::Matrix2d::Identity();
+        Eigen::Vector2d p = 0.5 * (a + b);
+        Eigen::Vector2d r = Eigen::Vector2d::Ones();
+        FIRIBuffers<2> &buf = ws.iter2;
+        buf.reserve(M, N);
+        Eigen::MatrixX3d &forwardH = buf.forwardH;
+        int &nH = buf.nH;
+        nH = 0;
+
+        for (int loop = 0; loop < iterations; ++loop)
+        {
+            const Eigen::Matrix2d forward = r.cwiseInverse().asDiagonal() * R.transpose();
+            const Eigen::Matrix2d backward = R * r.asDiagonal();
+            auto forwardB = buf.forwardB.topRows(M);
+            auto forwardD = buf.forwardD.head(M);
+            auto forwardPC = buf.forwardPC.leftCols(N);
+            forwardB.noalias() = bd.leftCols<2>().lazyProduct(backward);
+            forwardD = bd.rightCols<1>() + bd.leftCols<2>().lazyProduct(p);
+            for (int i = 0; i < N; i++)
+            {
+                forwardPC.col(i) = forward * (pc.col(i) - p);
+            }
+            const Eigen::Vector2d fwd_a = forward * (a - p);
+            const Eigen::Vector2d fwd_b = forward * (b - p);
+
+            auto distDs = buf.distDs.head(M);
+            auto distRs = buf.distRs.head(N);
+            auto tangents = buf.tangents.topRows(N);
+            distDs = forwardD.cwiseAbs().cwiseQuotient(forwardB.rowwise().norm());
+
+            for (int i = 0; i < N; i++)
+            {
+                distRs(i) = forwardPC.col(i).norm();
+                tangents(i, 2) = -distRs(i);
+                tangents.block<1, 2>(i, 0) = forwardPC.col(i).transpose() / distRs(i);
+                if (tangents.block<1, 2>(i, 0).dot(fwd_a) + tangents(i, 2) > epsilon)
+                {
+                    const Eigen::Vector2d delta = forwardPC.col(i) - fwd_a;
+                    tangents.block<1, 2>(i, 0) = fwd_a - (delta.dot(fwd_a) / delta.squaredNorm()) * delta;
+                    distRs(i) = tangents.block<1, 2>(i, 0).norm();
+                    tangents(i, 2) = -distRs(i);
+                    tangents.block<1, 2>(i, 0) /= distRs(i);
+                }
+                if (tangents.block<1, 2>(i, 0).dot(fwd_b) + tangents(i, 2) > epsilon)
+                {
+                    const Eigen::Vector2d delta = forwardPC.col(i) - fwd_b;
+                    tangents.block<1, 2>(i, 0) = fwd_b - (delta.dot(fwd_b) / delta.squaredNorm()) * delta;
+                    distRs(i) = tangents.block<1, 2>(i, 0).norm();
+                    tangents(i, 2) = -distRs(i);
+                    tangents.block<1, 2>(i, 0) /= distRs(i);
+                }
+                if (tangents.block<1, 2>(i, 0).dot(fwd_a) + tangents(i, 2) > epsilon)
+                {
+                    // the point is (almost) on the segment, take the line through it
+                    const Eigen::Vector2d ab = fwd_b - fwd_a;
+                    tangents.block<1, 2>(i, 0) = Eigen::Vector2d(-ab(1), ab(0)).normalized();
+                    tangents(i, 2) = -tangents.block<1, 2>(i, 0).dot(fwd_a);
+                    tangents.row(i) *= tangents(i, 2) > 0.0 ? -1.0 : 1.0;
+                }
+            }
+
+            auto bdFlags = buf.bdFlags.head(M);
+            auto pcFlags = buf.pcFlags.head(N);
+            bdFlags.setOnes();
+            pcFlags.setOnes();
+
+            nH = 0;
+
+            bool completed = false;
+            int bdMinId = 0, pcMinId = 0;
+            double minSqrD = distDs.minCoeff(&bdMinId);
+            double minSqrR = INFINITY;
+            if (distRs.size() != 0)
+            {
+                minSqrR = distRs.minCoeff(&pcMinId);
+            }
+            for (int i = 0; !completed && i < (M + N); ++i)
+            {
+                if (minSqrD < minSqrR)
+                {
+                    forwardH.block<1, 2>(nH, 0) = forwardB.row(bdMinId);
+                    forwardH(nH, 2) = forwardD(bdMinId);
+                    bdFlags(bdMinId) = 0;
+                }
+                else
+                {
+                    forwardH.row(nH) = tangents.row(pcMinId);
+                    pcFlags(pcMinId) = 0;
+                }
+
+                completed = true;
+                minSqrD = INFINITY;
+                for (int j = 0; j < M; ++j)
+                {
+                    if (bdFlags(j))
+                    {
+                        completed = false;
+                        if (minSqrD > distDs(j))
+                        {
+                            bdMinId = j;
+                            minSqrD = distDs(j);
+                        }
+                    }
+                }
+                minSqrR = INFINITY;
+                for (int j = 0; j < N; ++j)
+                {
+                    if (pcFlags(j))
+                    {
+                        if (forwardH.block<1, 2>(nH, 0).dot(forwardPC.col(j)) + forwardH(nH, 2) > -epsilon)
+                        {
+                            pcFlags(j) = 0;
+                        }
+                        else
+                        {
+                            completed = false;
+                            if (minSqrR > distRs(j))
+                            {
+                                pcMinId = j;
+                                minSqrR = distRs(j);
+                            }
+                        }
+                    }
+                }
+                ++nH;
+            }
+
+            for (int i = 0; i < nH; ++i)
+            {
+                buf.hPoly.block<1, 2>(i, 0) = forwardH.block<1, 2>(i, 0) * forward;
+                buf.hPoly(i, 2) = forwardH(i, 2) - buf.hPoly.block<1, 2>(i, 0).dot(p);
+            }
+
+            if (loop == iterations - 1)
+            {
+                break;
+            }
+
+            if (!maxVolInsEllipse(buf.result(), R, p, r, ws))
+                return false;
+        }
+
+        return true;
+    }
+
+    inline bool firi2d(const Eigen::Ref<const Eigen::MatrixX3d> &bd,
+                       const Eigen::Ref<const Eigen::Matrix2Xd> &pc,
+                       const Eigen::Vector2d &a,
+                       const Eigen::Vector2d &b,
+                       Eigen::MatrixX3d &hPoly,
+                       MVIEWorkspace &ws,
+                       const int iterations = 4,
+                       const double epsilon = 1.0e-6)
+    {
+        if (!firi2d(bd, pc, a, b, ws, iterations, epsilon))
+        {
+            return false;
+        }
+        hPoly = ws.iter2.result();
+        return true;
+    }
+
+    inline bool firi2d(const Eigen::Ref<const Eigen::MatrixX3d> &bd,
+                       const Eigen::Ref<const Eigen::Matrix2Xd> &pc,
+                       const Eigen::Vector2d &a,
+                       const Eigen::Vector2d &b,
+                       Eigen::MatrixX3d &hPoly,
+                       const int iterations = 4,
+                       const double epsilon = 1.0e-6)
+    {
+        return firi2d(bd, pc, a, b, hPoly, default_workspace(), iterations, epsilon);
+    }
+
 }
 
 #endif
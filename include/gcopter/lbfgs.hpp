@@ -128,6 +128,18 @@ namespace lbfgs
         double machine_prec = 1.0e-16;
     };
 
+    /**
+     * Intermediate vectors of lbfgs_optimize(). A client program that solves
+     *  many problems of the same size can keep one and pass it to every call,
+     *  so they are only allocated once. One workspace serves one call at a time.
+     */
+    struct lbfgs_workspace_t
+    {
+        Eigen::VectorXd xp, g, gp, d, pf;
+        Eigen::VectorXd lm_alpha, lm_ys;
+        Eigen::MatrixXd lm_s, lm_y;
+    };
+
     /**
      * Return values of lbfgs_optimize().
      *  Roughly speaking, a negative value indicates an error.
@@ -427,6 +439,9 @@ namespace lbfgs
      *  @param  instance        A user data pointer for client programs. The callback
      *                          functions will receive the value of this argument.
      *  @param  param           The parameters for L-BFGS optimization.
+     *  @param  work            Workspace for the intermediate vectors, kept by
+     *                          the client between calls. If it is nullptr they
+     *                          are allocated for this call only.
      *  @retval int             The status code. This function returns a nonnegative 
      *                          integer if the minimization process terminates without 
      *                          an error. A negative integer indicates an error.
@@ -437,7 +452,8 @@ namespace lbfgs
                               lbfgs_stepbound_t proc_stepbound,
                               lbfgs_progress_t proc_progress,
                               void *instance,
-                              const lbfgs_parameter_t &param)
+                              const lbfgs_parameter_t &param,
+                              lbfgs_workspace_t *work = nullptr)
     {
         int ret, i, j, k, ls, end, bound;
         double step, step_min, step_max, fx, ys, yy;
@@ -495,17 +511,28 @@ namespace lbfgs
         }
 
         /* Prepare intermediate variables. */
-        Eigen::VectorXd xp(n);
-        Eigen::VectorXd g(n);
-        Eigen::VectorXd gp(n);
-        Eigen::VectorXd d(n);
-        Eigen::VectorXd pf(std::max(1, param.past));
+        lbfgs_workspace_t local;
+        lbfgs_workspace_t &ws = work ? *work : local;
+        Eigen::VectorXd &xp = ws.xp;
+        Eigen::VectorXd &g = ws.g;
+        Eigen::VectorXd &gp = ws.gp;
+        Eigen::VectorXd &d = ws.d;
+        Eigen::VectorXd &pf = ws.pf;
+        xp.resize(n);
+        g.resize(n);
+        gp.resize(n);
+        d.resize(n);
+        pf.resize(std::max(1, param.past));
 
         /* Initialize the limited memory. */
-        Eigen::VectorXd lm_alpha = Eigen::VectorXd::Zero(m);
-        Eigen::MatrixXd lm_s = Eigen::MatrixXd::Zero(n, m);
-        Eigen::MatrixXd lm_y = Eigen::MatrixXd::Zero(n, m);
-        Eigen::VectorXd lm_ys = Eigen::VectorXd::Zero(m);
+        Eigen::VectorXd &lm_alpha = ws.lm_alpha;
+        Eigen::MatrixXd &lm_s = ws.lm_s;
+        Eigen::MatrixXd &lm_y = ws.lm_y;
+        Eigen::VectorXd &lm_ys = ws.lm_ys;
+        lm_alpha.setZero(m);
+        lm_s.setZero(n, m);
+        lm_y.setZero(n, m);
+        lm_ys.setZero(m);
 
         /* Construct a callback data. */
         callback_data_t cd;
@@ -29,6 +29,7 @@
 #include <Eigen/Eigen>
 #include <cmath>
 #include <random>
+#include <vector>
 
 namespace sdlp
 {
@@ -683,13 +684,21 @@ namespace sdlp
         }
     }
 
+    /* generator of the random plane order of linprog, one per thread so
+       LPs can be solved in parallel; reseed it for reproducible results */
+    inline std::mt19937_64 &rand_engine()
+    {
+        static thread_local std::mt19937_64 gen;
+        return gen;
+    }
+
     inline void rand_permutation(const int n,
                                  int *p)
     {
         typedef std::uniform_int_distribution<int> rand_int;
         typedef rand_int::param_type rand_range;
-        static std::mt19937_64 gen;
-        static rand_int rdi(0, 1);
+        std::mt19937_64 &gen = rand_engine();
+        rand_int rdi(0, 1);
         int j, k;
         for (int i = 0; i < n; i++)
         {
@@ -705,11 +714,27 @@ namespace sdlp
         }
     }
 
+    /* scratch of linprog, it only grows. Keep one per thread, it is not
+       safe to share. */
+    struct LPWorkspace
+    {
+        std::vector<int> intBuf;
+        std::vector<double> dblBuf;
+    };
+
+    /* workspace of the calls that don't bring their own, one per thread */
+    inline LPWorkspace &default_lp_workspace()
+    {
+        static thread_local LPWorkspace ws;
+        return ws;
+    }
+
     template <int d>
     inline double linprog(const Eigen::Matrix<double, d, 1> &c,
-                          const Eigen::Matrix<double, -1, d> &A,
-                          const Eigen::Matrix<double, -1, 1> &b,
-                          Eigen::Matrix<double, d, 1> &x)
+                          const Eigen::Ref<const Eigen::Matrix<double, -1, d>> &A,
+                          const Eigen::Ref<const Eigen::Matrix<double, -1, 1>> &b,
+                          Eigen::Matrix<double, d, 1> &x,
+                          LPWorkspace &ws)
     /*
     **  min cTx, s.t. Ax<=b
     **  dim(x) << dim(b)
@@ -722,22 +747,37 @@ namespace sdlp
             return c.cwiseAbs().maxCoeff() > 0.0 ? -INFINITY : 0.0;
         }
 
-        Eigen::VectorXi perm(m - 1);
-        Eigen::VectorXi next(m);
+        std::vector<int> &intBuf = ws.intBuf;
+        std::vector<double> &dblBuf = ws.dblBuf;
+        const int workSize = (m + 3) * (d + 2) * (d - 1) / 2;
+        if (intBuf.size() < (size_t)(3 * m))
+        {
+            intBuf.resize(3 * m);
+        }
+        if (dblBuf.size() < (size_t)((d + 1) * m + workSize))
+        {
+            dblBuf.resize((d + 1) * m + workSize);
+        }
+
+        Eigen::Map<Eigen::VectorXi> perm(intBuf.data(), m - 1);
+        Eigen::Map<Eigen::VectorXi> next(perm.data() + m - 1, m);
         /* original allocated size is m, here changed to m + 1 for legal tail accessing */
-        Eigen::VectorXi prev(m + 1);
+        Eigen::Map<Eigen::VectorXi> prev(next.data() + m, m + 1);
         Eigen::Matrix<double, d + 1, 1> n_vec;
         Eigen::Matrix<double, d + 1, 1> d_vec;
         Eigen::Matrix<double, d + 1, 1> opt;
-        Eigen::Matrix<double, d + 1, -1, Eigen::ColMajor> halves(d + 1, m);
-        Eigen::VectorXd work((m + 3) * (d + 2) * (d - 1) / 2);
+        Eigen::Map<Eigen::Matrix<double, d + 1, -1, Eigen::ColMajor>> halves(dblBuf.data(), d + 1, m);
+        Eigen::Map<Eigen::VectorXd> work(halves.data() + (d + 1) * m, workSize);
 
         halves.col(0).setZero();
         halves(d, 0) = 1.0;
         halves.topRightCorner(d, m - 1) = -A.transpose();
         halves.bottomRightCorner(1, m - 1) = b.transpose();
         /* normalize all halves as required in linfracprog */
-        halves.colwise().normalize();
+        for (int i = 0; i < m; i++)
+        {
+            halves.col(i).normalize();
+        }
         n_vec.head(d) = c;
         n_vec(d) = 0.0;
         d_vec.setZero();
@@ -784,6 +824,15 @@ namespace sdlp
         return minimum;
     }
 
+    template <int d>
+    inline double linprog(const Eigen::Matrix<double, d, 1> &c,
+                          const Eigen::Ref<const Eigen::Matrix<double, -1, d>> &A,
+                          const Eigen::Ref<const Eigen::Matrix<double, -1, 1>> &b,
+                          Eigen::Matrix<double, d, 1> &x)
+    {
+        return linprog<d>(c, A, b, x, default_lp_workspace());
+    }
+
 } // namespace sdlp
 
 #endif
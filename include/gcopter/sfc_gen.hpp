@@ -27,13 +27,7 @@
 
 #include "geo_utils.hpp"
 #include "firi.hpp"
-
-#include <ompl/util/Console.h>
-#include <ompl/base/SpaceInformation.h>
-#include <ompl/base/spaces/RealVectorStateSpace.h>
-#include <ompl/geometric/planners/rrt/InformedRRTstar.h>
-#include <ompl/base/objectives/PathLengthOptimizationObjective.h>
-#include <ompl/base/DiscreteMotionValidator.h>
+#include "voxel_jps.hpp"
 
 #include <deque>
 #include <memory>
@@ -42,6 +36,12 @@
 namespace sfc_gen
 {
 
+    // Plan with a JPS3D whose map has already been set from mapPtr (see
+    // voxel_jps::JPS3D::setMap), so that it can be reused between calls.
+    // The search is limited to the voxels inside [lb, hb] and gives up
+    // after timeout seconds (<= 0 for no limit). p goes from s through
+    // the centers of the jump points to g. Returns the length of p, or
+    // INFINITY if no path was found.
     template <typename Map>
     inline double planPath(const Eigen::Vector3d &s,
                            const Eigen::Vector3d &g,
@@ -49,70 +49,49 @@ namespace sfc_gen
                            const Eigen::Vector3d &hb,
                            const Map *mapPtr,
                            const double &timeout,
-                           std::vector<Eigen::Vector3d> &p)
+                           std::vector<Eigen::Vector3d> &p,
+                           voxel_jps::JPS3D &jps)
     {
-        auto space(std::make_shared<ompl::base::RealVectorStateSpace>(3));
-
-        ompl::base::RealVectorBounds bounds(3);
-        bounds.setLow(0, 0.0);
-        bounds.setHigh(0, hb(0) - lb(0));
-        bounds.setLow(1, 0.0);
-        bounds.setHigh(1, hb(1) - lb(1));
-        bounds.setLow(2, 0.0);
-        bounds.setHigh(2, hb(2) - lb(2));
-        space->setBounds(bounds);
+        const Eigen::Vector3i size = mapPtr->getSize();
+        const Eigen::Vector3i lo = mapPtr->posD2I(lb).cwiseMax(Eigen::Vector3i::Zero());
+        const Eigen::Vector3i hi = mapPtr->posD2I(hb).cwiseMin(size - Eigen::Vector3i::Ones());
 
-        auto si(std::make_shared<ompl::base::SpaceInformation>(space));
+        std::vector<Eigen::Vector3i> ids;
+        if (jps.search(mapPtr->posD2I(s), mapPtr->posD2I(g), lo, hi, timeout, ids) == INFINITY)
+        {
+            return INFINITY;
+        }
 
-        si->setStateValidityChecker(
-            [&](const ompl::base::State *state)
-            {
-                const auto *pos = state->as<ompl::base::RealVectorStateSpace::StateType>();
-                const Eigen::Vector3d position(lb(0) + (*pos)[0],
-                                               lb(1) + (*pos)[1],
-                                               lb(2) + (*pos)[2]);
-                return mapPtr->query(position) == 0;
-            });
-        si->setup();
-
-        ompl::msg::setLogLevel(ompl::msg::LOG_NONE);
-
-        ompl::base::ScopedState<> start(space), goal(space);
-        start[0] = s(0) - lb(0);
-        start[1] = s(1) - lb(1);
-        start[2] = s(2) - lb(2);
-        goal[0] = g(0) - lb(0);
-        goal[1] = g(1) - lb(1);
-        goal[2] = g(2) - lb(2);
-
-        auto pdef(std::make_shared<ompl::base::ProblemDefinition>(si));
-        pdef->setStartAndGoalStates(start, goal);
-        pdef->setOptimizationObjective(std::make_shared<ompl::base::PathLengthOptimizationObjective>(si));
-        auto planner(std::make_shared<ompl::geometric::InformedRRTstar>(si));
-        planner->setProblemDefinition(pdef);
-        planner->setup();
-
-        ompl::base::PlannerStatus solved;
-        solved = planner->ompl::base::Planner::solve(timeout);
-
-        double cost = INFINITY;
-        if (solved)
+        p.clear();
+        p.push_back(s);
+        for (size_t i = 1; i + 1 < ids.size(); i++)
         {
-            p.clear();
-            const ompl::geometric::PathGeometric path_ =
-                ompl::geometric::PathGeometric(
-                    dynamic_cast<const ompl::geometric::PathGeometric &>(*pdef->getSolutionPath()));
-            for (size_t i = 0; i < path_.getStateCount(); i++)
-            {
-                const auto state = path_.getState(i)->as<ompl::base::RealVectorStateSpace::StateType>()->values;
-                p.emplace_back(lb(0) + state[0], lb(1) + state[1], lb(2) + state[2]);
-            }
-            cost = pdef->getSolutionPath()->cost(pdef->getOptimizationObjective()).value();
+            p.push_back(mapPtr->posI2D(ids[i]));
         }
+        p.push_back(g);
 
+        double cost = 0.0;
+        for (size_t i = 1; i < p.size(); i++)
+        {
+            cost += (p[i] - p[i - 1]).norm();
+        }
         return cost;
     }
 
+    template <typename Map>
+    inline double planPath(const Eigen::Vector3d &s,
+                           const Eigen::Vector3d &g,
+                           const Eigen::Vector3d &lb,
+                           const Eigen::Vector3d &hb,
+                           const Map *mapPtr,
+                           const double &timeout,
+                           std::vector<Eigen::Vector3d> &p)
+    {
+        voxel_jps::JPS3D jps;
+        jps.setMap(mapPtr->getVoxels(), mapPtr->getSize());
+        return planPath(s, g, lb, hb, mapPtr, timeout, p, jps);
+    }
+
     inline void convexCover(const std::vector<Eigen::Vector3d> &path,
                             const std::vector<Eigen::Vector3d> &points,
                             const Eigen::Vector3d &lowCorner,
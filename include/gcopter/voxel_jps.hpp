@@ -0,0 +1,531 @@
+#ifndef VOXEL_JPS_HPP
+#define VOXEL_JPS_HPP
+
+#include <Eigen/Eigen>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace voxel_jps
+{
+
+    // Jump point search on a 26-connected voxel grid, stored x fastest,
+    // then y, then z (the layout of voxel_map::VoxelMap), where any
+    // nonzero voxel is blocked. Moves cost their euclidean length and are
+    // allowed whenever the target voxel is free. Successors follow the
+    // canonical ordering of paths, most diagonal moves first: a neighbor
+    // is natural if the move to it continues the canonical path from the
+    // parent, and forced if that canonical path is blocked.
+    //
+    // Straight scans along all three axes run 64 voxels at a time over
+    // bit-packed lines of the grid (one copy of the grid per axis), and
+    // the per voxel search state is stamped with a generation, so it is
+    // only allocated when the grid size changes and never cleared.
+    class JPS3D
+    {
+    public:
+        JPS3D()
+            : nx(0), ny(0), nz(0), vox(nullptr), generation(0)
+        {
+            buildTables();
+        }
+
+    private:
+        struct Lines
+        {
+            int len, nu, nv, words;
+            std::vector<uint64_t> bits;
+        };
+
+        struct Entry
+        {
+            double f, g;
+            int idx;
+        };
+
+        int nx, ny, nz;
+        const uint8_t *vox;
+        Lines lines[3];
+        Eigen::Vector3i lo, hi, goal;
+        int goalIdx;
+
+        // per direction (see dirId): offset, length, natural successors,
+        // the natural successors other than itself which a diagonal jump
+        // scans at every step, and the (blocked voxel, forced neighbor)
+        // offset pairs
+        int dirs[27][3];
+        double dirLen[27];
+        std::vector<int> natural[27], subs[27];
+        std::vector<std::pair<int, int>> forced[27];
+
+        std::vector<uint32_t> openGen, closedGen;
+        std::vector<double> gcost;
+        std::vector<int> parent;
+        uint32_t generation;
+        std::vector<Entry> heap;
+
+        static inline int dirId(const int &dx, const int &dy, const int &dz)
+        {
+            return (dx + 1) + 3 * (dy + 1) + 9 * (dz + 1);
+        }
+
+        static inline int sgn(const int &v)
+        {
+            return (v > 0) - (v < 0);
+        }
+
+        static inline bool greater(const Entry &a, const Entry &b)
+        {
+            // deeper nodes first among equal f-costs
+            return a.f > b.f || (a.f == b.f && a.g < b.g);
+        }
+
+        inline void buildTables()
+        {
+            for (int id = 0; id < 27; id++)
+            {
+                dirs[id][0] = id % 3 - 1;
+                dirs[id][1] = id / 3 % 3 - 1;
+                dirs[id][2] = id / 9 - 1;
+                dirLen[id] = std::sqrt((double)(std::abs(dirs[id][0]) + std::abs(dirs[id][1]) + std::abs(dirs[id][2])));
+            }
+
+            for (int d = 0; d < 27; d++)
+            {
+                if (d == 13)
+                {
+                    continue;
+                }
+                const int *dv = dirs[d];
+                for (int e = 0; e < 27; e++)
+                {
+                    if (e == 13)
+                    {
+                        continue;
+                    }
+                    const int *ev = dirs[e];
+
+                    // sub-directions of d are natural
+                    bool sub = true;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        sub = sub && (ev[i] == 0 || ev[i] == dv[i]);
+                    }
+                    if (sub)
+                    {
+                        natural[d].push_back(e);
+                        if (e != d)
+                        {
+                            subs[d].push_back(e);
+                        }
+                        continue;
+                    }
+
+                    // the parent reaches e in one move unless the two moves
+                    // add up to 2 along some axis, in which case the
+                    // canonical path takes the most diagonal move m1 first
+                    int v[3], m1[3];
+                    bool two = false;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        v[i] = dv[i] + ev[i];
+                        m1[i] = sgn(v[i]);
+                        two = two || std::abs(v[i]) == 2;
+                    }
+                    if (two)
+                    {
+                        forced[d].emplace_back(dirId(m1[0] - dv[0], m1[1] - dv[1], m1[2] - dv[2]), e);
+                    }
+                }
+            }
+        }
+
+        inline int index(const int &x, const int &y, const int &z) const
+        {
+            return x + nx * (y + ny * z);
+        }
+
+        inline bool isFree(const int &x, const int &y, const int &z) const
+        {
+            return x >= lo(0) && y >= lo(1) && z >= lo(2) &&
+                   x <= hi(0) && y <= hi(1) && z <= hi(2) &&
+                   vox[index(x, y, z)] == 0;
+        }
+
+        inline bool hasForced(const int &x, const int &y, const int &z, const int &d) const
+        {
+            for (const std::pair<int, int> &fn : forced[d])
+            {
+                const int *f = dirs[fn.first];
+                const int *n = dirs[fn.second];
+                if (!isFree(x + f[0], y + f[1], z + f[2]) &&
+                    isFree(x + n[0], y + n[1], z + n[2]))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Scan the line of axis a through (u, v) from position s (excluded)
+        // in direction dir until the first voxel that is blocked (wall is
+        // set) or has a forced neighbor, and return its position. Padding
+        // bits around every line and padding lines around the grid are
+        // set, so the scan always stops inside the padded line.
+        inline int scanLine(const int &a, const int &u, const int &v,
+                            const int &s, const int &dir, bool &wall) const
+        {
+            const Lines &L = lines[a];
+            const int W = L.words;
+            const int stride = L.nu + 2;
+            const uint64_t *line = &L.bits[((v + 1) * stride + u + 1) * W];
+            const uint64_t *side[8];
+            int k = 0;
+            for (int dv = -1; dv <= 1; dv++)
+            {
+                for (int du = -1; du <= 1; du++)
+                {
+                    if (du != 0 || dv != 0)
+                    {
+                        side[k++] = line + (dv * stride + du) * W;
+                    }
+                }
+            }
+
+            // bit b holds position b - 1
+            if (dir > 0)
+            {
+                const int p = s + 2;
+                uint64_t mask = ~0ULL << (p & 63);
+                for (int w = p >> 6; w < W; w++, mask = ~0ULL)
+                {
+                    uint64_t fn = 0;
+                    for (int i = 0; i < 8; i++)
+                    {
+                        const uint64_t next = w + 1 < W ? side[i][w + 1] << 63 : 1ULL << 63;
+                        fn |= side[i][w] & ~((side[i][w] >> 1) | next);
+                    }
+                    const uint64_t stop = (line[w] | fn) & mask;
+                    if (stop)
+                    {
+                        const int b = (w << 6) + __builtin_ctzll(stop);
+                        wall = (line[b >> 6] >> (b & 63)) & 1ULL;
+                        return b - 1;
+                    }
+                }
+            }
+            else
+            {
+                const int p = s;
+                uint64_t mask = (p & 63) == 63 ? ~0ULL : (1ULL << ((p & 63) + 1)) - 1;
+                for (int w = p >> 6; w >= 0; w--, mask = ~0ULL)
+                {
+                    uint64_t fn = 0;
+                    for (int i = 0; i < 8; i++)
+                    {
+                        const uint64_t prev = w > 0 ? side[i][w - 1] >> 63 : 1ULL;
+                        fn |= side[i][w] & ~((side[i][w] << 1) | prev);
+                    }
+                    const uint64_t stop = (line[w] | fn) & mask;
+                    if (stop)
+                    {
+                        const int b = (w << 6) + 63 - __builtin_clzll(stop);
+                        wall = (line[b >> 6] >> (b & 63)) & 1ULL;
+                        return b - 1;
+                    }
+                }
+            }
+
+            wall = true;
+            return s;
+        }
+
+        // Jump from (x, y, z) in direction d. Returns the index of the
+        // jump point and the number of steps to it, or -1.
+        inline int jump(int x, int y, int z, const int &d, int &steps) const
+        {
+            const int *dv = dirs[d];
+            steps = 0;
+
+            if (std::abs(dv[0]) + std::abs(dv[1]) + std::abs(dv[2]) == 1)
+            {
+                const int a = dv[0] != 0 ? 0 : (dv[1] != 0 ? 1 : 2);
+                const int dir = dv[a];
+                int c[3] = {x, y, z};
+                const int u = a == 0 ? y : x;
+                const int v = a == 2 ? y : z;
+
+                bool wall;
+                const int t = scanLine(a, u, v, c[a], dir, wall);
+
+                // the goal may be on the line before the scan stopped
+                int gc[3] = {goal(0), goal(1), goal(2)};
+                bool onLine = true;
+                for (int i = 0; i < 3; i++)
+                {
+                    onLine = onLine && (i == a || gc[i] == c[i]);
+                }
+                const int kg = (gc[a] - c[a]) * dir;
+                if (onLine && kg >= 1 && kg <= (t - c[a]) * dir)
+                {
+                    steps = kg;
+                    return goalIdx;
+                }
+
+                if (wall || t < lo(a) || t > hi(a))
+                {
+                    return -1;
+                }
+                steps = (t - c[a]) * dir;
+                c[a] = t;
+                return index(c[0], c[1], c[2]);
+            }
+
+            while (true)
+            {
+                x += dv[0];
+                y += dv[1];
+                z += dv[2];
+                steps++;
+                if (!isFree(x, y, z))
+                {
+                    return -1;
+                }
+
+                const int idx = index(x, y, z);
+                if (idx == goalIdx || hasForced(x, y, z, d))
+                {
+                    return idx;
+                }
+
+                int st;
+                for (const int &e : subs[d])
+                {
+                    if (jump(x, y, z, e, st) >= 0)
+                    {
+                        return idx;
+                    }
+                }
+            }
+        }
+
+        inline double heuristic(const int &x, const int &y, const int &z) const
+        {
+            int d[3] = {std::abs(goal(0) - x), std::abs(goal(1) - y), std::abs(goal(2) - z)};
+            std::sort(d, d + 3);
+            return std::sqrt(3.0) * d[0] + std::sqrt(2.0) * (d[1] - d[0]) + (d[2] - d[1]);
+        }
+
+        inline void push(const int &idx, const int &from, const double &g)
+        {
+            if (closedGen[idx] == generation ||
+                (openGen[idx] == generation && g >= gcost[idx] - 1.0e-9))
+            {
+                return;
+            }
+            openGen[idx] = generation;
+            gcost[idx] = g;
+            parent[idx] = from;
+
+            const int x = idx % nx;
+            const int y = idx / nx % ny;
+            const int z = idx / (nx * ny);
+            Entry e = {g + heuristic(x, y, z), g, idx};
+            heap.push_back(e);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+
+    public:
+        // Use the given voxels for the next searches. They are read during
+        // the search, so they must outlive it, and setMap has to be called
+        // again after they change.
+        inline void setMap(const std::vector<uint8_t> &voxels,
+                           const Eigen::Vector3i &size)
+        {
+            vox = voxels.data();
+            if (size(0) != nx || size(1) != ny || size(2) != nz)
+            {
+                nx = size(0);
+                ny = size(1);
+                nz = size(2);
+                const int n = nx * ny * nz;
+                openGen.assign(n, 0);
+                closedGen.assign(n, 0);
+                gcost.assign(n, 0.0);
+                parent.assign(n, -1);
+                generation = 0;
+            }
+
+            const int len[3] = {nx, ny, nz};
+            const int nu[3] = {ny, nx, nx};
+            const int nv[3] = {nz, nz, ny};
+            for (int a = 0; a < 3; a++)
+            {
+                Lines &L = lines[a];
+                L.len = len[a];
+                L.nu = nu[a];
+                L.nv = nv[a];
+                L.words = (L.len + 2 + 63) / 64;
+                L.bits.assign((size_t)(L.nu + 2) * (L.nv + 2) * L.words, ~0ULL);
+            }
+
+            // clear the bits of the free voxels, everything else (padding
+            // included) stays blocked. x lines are built a word at a time
+            const int wx = lines[0].words, wy = lines[1].words, wz = lines[2].words;
+            for (int z = 0; z < nz; z++)
+            {
+                uint64_t *ylines = &lines[1].bits[((size_t)(z + 1) * (nx + 2) + 1) * wy];
+                for (int y = 0; y < ny; y++)
+                {
+                    const uint8_t *row = vox + index(0, y, z);
+                    uint64_t *xline = &lines[0].bits[((size_t)(z + 1) * (ny + 2) + y + 1) * wx];
+                    uint64_t *zlines = &lines[2].bits[((size_t)(y + 1) * (nx + 2) + 1) * wz];
+                    const int by = y + 1, bz = z + 1;
+                    uint64_t word = xline[0];
+                    for (int x = 0; x < nx; x++)
+                    {
+                        const uint64_t free = row[x] == 0;
+                        const int bx = x + 1;
+                        word &= ~(free << (bx & 63));
+                        if ((bx & 63) == 63 || x == nx - 1)
+                        {
+                            xline[bx >> 6] = word;
+                            word = xline[(bx >> 6) + 1 < wx ? (bx >> 6) + 1 : bx >> 6];
+                        }
+                        ylines[x * wy + (by >> 6)] &= ~(free << (by & 63));
+                        zlines[x * wz + (bz >> 6)] &= ~(free << (bz & 63));
+                    }
+                }
+            }
+        }
+
+        // Search from voxel s to voxel g inside the box [lo, hi] (voxels
+        // outside of it count as blocked). timeout bounds the wall clock
+        // time in seconds, <= 0 for none. path is filled with the jump
+        // points from s to g. Returns the path length in voxels, INFINITY
+        // if there is no path or the search timed out.
+        inline double search(const Eigen::Vector3i &s,
+                             const Eigen::Vector3i &g,
+                             const Eigen::Vector3i &boxLo,
+                             const Eigen::Vector3i &boxHi,
+                             const double &timeout,
+                             std::vector<Eigen::Vector3i> &path)
+        {
+            path.clear();
+            if (vox == nullptr)
+            {
+                return INFINITY;
+            }
+
+            lo = boxLo.cwiseMax(Eigen::Vector3i::Zero());
+            hi = boxHi.cwiseMin(Eigen::Vector3i(nx - 1, ny - 1, nz - 1));
+            goal = g;
+            if (!isFree(s(0), s(1), s(2)) || !isFree(g(0), g(1), g(2)))
+            {
+                return INFINITY;
+            }
+            goalIdx = index(g(0), g(1), g(2));
+            const int startIdx = index(s(0), s(1), s(2));
+
+            if (++generation == 0)
+            {
+                std::fill(openGen.begin(), openGen.end(), 0);
+                std::fill(closedGen.begin(), closedGen.end(), 0);
+                generation = 1;
+            }
+            heap.clear();
+
+            const auto t0 = std::chrono::steady_clock::now();
+            int expansions = 0;
+
+            push(startIdx, startIdx, 0.0);
+            while (!heap.empty())
+            {
+                std::pop_heap(heap.begin(), heap.end(), greater);
+                const Entry top = heap.back();
+                heap.pop_back();
+
+                const int idx = top.idx;
+                if (closedGen[idx] == generation || top.g > gcost[idx] + 1.0e-9)
+                {
+                    continue;
+                }
+                closedGen[idx] = generation;
+
+                if (idx == goalIdx)
+                {
+                    for (int i = idx; i != startIdx; i = parent[i])
+                    {
+                        path.emplace_back(i % nx, i / nx % ny, i / (nx * ny));
+                    }
+                    path.push_back(s);
+                    std::reverse(path.begin(), path.end());
+                    return top.g;
+                }
+
+                if (timeout > 0.0 && (++expansions & 63) == 0 &&
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() > timeout)
+                {
+                    return INFINITY;
+                }
+
+                const int x = idx % nx;
+                const int y = idx / nx % ny;
+                const int z = idx / (nx * ny);
+
+                // successors: every direction from the start, otherwise the
+                // natural and forced neighbors of the direction of arrival
+                uint32_t cand = 0;
+                if (idx == startIdx)
+                {
+                    cand = ((1u << 27) - 1) & ~(1u << 13);
+                }
+                else
+                {
+                    const int p = parent[idx];
+                    const int d = dirId(sgn(x - p % nx), sgn(y - p / nx % ny), sgn(z - p / (nx * ny)));
+                    for (const int &e : natural[d])
+                    {
+                        cand |= 1u << e;
+                    }
+                    for (const std::pair<int, int> &fn : forced[d])
+                    {
+                        const int *f = dirs[fn.first];
+                        if (!isFree(x + f[0], y + f[1], z + f[2]))
+                        {
+                            cand |= 1u << fn.second;
+                        }
+                    }
+                }
+
+                for (int e = 0; e < 27; e++)
+                {
+                    if (!((cand >> e) & 1u))
+                    {
+                        continue;
+                    }
+                    const int *ev = dirs[e];
+                    if (!isFree(x + ev[0], y + ev[1], z + ev[2]))
+                    {
+                        continue;
+                    }
+                    int steps;
+                    const int jp = jump(x, y, z, e, steps);
+                    if (jp >= 0)
+                    {
+                        push(jp, idx, top.g + steps * dirLen[e]);
+                    }
+                }
+            }
+
+            return INFINITY;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef HPA_GRAPH_H
+#define HPA_GRAPH_H
+
+#include <vector>
+#include <cstdint>
+
+/**********************************************************************
+  Abstract graph over a grid for hierarchical path planning (HPA*,
+  Botea et al. 2004). The grid is cut into square clusters, the free
+  cells on both sides of a cluster border form entrances, and the
+  abstract graph links the entrance cells of a cluster with their
+  shortest distance inside that cluster, and the two cells of an
+  entrance with each other. A route over this graph is a coarse path
+  which JPSPlan then only has to refine close to the robot.
+
+  Same cost model as JPSPlan: 8-connected, every step costs 1. When
+  cells change only the clusters around them are rebuilt.
+***********************************************************************/
+class HPAGraph{
+
+public:
+    HPAGraph();
+
+    void set_occ_value(double x);
+    void set_blocked_rule(const uint8_t* rule);
+    void set_cluster_size(int size);
+    void set_map(const unsigned char* map, int sizeX, int sizeY);
+    void update_map(int x0, int xn, int y0, int yn);
+    bool plan(int start, int goal, std::vector<int>& route);
+
+    int get_num_nodes() const;
+    int get_num_expansions() const { return numExpansions; }
+
+private:
+
+    // entrance cells of a cluster, the cells of other clusters each of
+    // them is linked to, and the distances between them inside the
+    // cluster (nodes x nodes, -1 if not connected inside the cluster)
+    struct HPACluster{
+        std::vector<int> nodes;
+        std::vector<std::vector<int> > partners;
+        std::vector<int> dist;
+    };
+
+    // a pair of cells on both sides of a cluster border, a is in the
+    // cluster to the left / below
+    struct HPATransition{
+        int a, b;
+    };
+
+    bool blocked(int ind) const { return occ[ind]; }
+    int cluster_of(int ind) const;
+    int local_index(const HPACluster& cl, int cell) const;
+    void build();
+    void build_border(int c, bool vertical);
+    void build_cluster(int c);
+    void add_node(HPACluster& cl, int cell, int partner);
+    void cluster_bfs(int c, int source);
+    int cluster_dist(int cell) const;
+
+    const unsigned char* _map;
+    int sizeX, sizeY, clusterSize, clustersX, clustersY, numExpansions;
+    bool built;
+
+    // blocked flag of every cost value (see set_blocked_rule)
+    uint8_t blockedLut[256];
+
+    // snapshot of the blocked cells the graph was built on
+    std::vector<uint8_t> occ;
+
+    std::vector<HPACluster> clusters;
+
+    // borders to the cluster on the right (vertical) and above
+    // (horizontal) of every cluster
+    std::vector<std::vector<HPATransition> > vBorders;
+    std::vector<std::vector<HPATransition> > hBorders;
+
+    // scratch space of cluster_bfs, distances local to the cluster
+    std::vector<int> bfsDist;
+    std::vector<int> bfsQueue;
+    int bfsX0, bfsY0, bfsW, bfsH;
+
+};
+
+#endif
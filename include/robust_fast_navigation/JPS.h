@@ -1,11 +1,13 @@
 #ifndef JPS_H
 #define JPS_H
 
-#include <map>
-#include <queue>
+#include <memory>
 #include <vector>
+#include <cstdint>
 #include <Eigen/Core>
 
+#include <robust_fast_navigation/JPSLandmarks.h>
+
 struct JPSNode{
     bool isValid = true;
     int x, y;
@@ -24,23 +26,107 @@ class Compare{
     }
 };
 
+// Work done by the last call to JPSPlan::JPS()
+struct JPSStats{
+    int pushes;         // nodes pushed onto the open list
+    int pops;           // nodes popped off and expanded
+    int cellsScanned;   // cells stepped over by the scans (one per table
+                        // lookup for JPS+, one per word for block scans)
+    int closedHits;     // pushes / pops dropped as already closed or stale
+    double time;        // wall clock time of the search, in seconds
+};
+
+// How JPSPlan finds the next jump point along a direction
+enum JPSScanMode{
+    SCAN_CELLS,     // walk the grid one cell at a time
+    SCAN_JPS_PLUS,  // look up precomputed jump distances (JPS+)
+    SCAN_BLOCK      // scan 64 cells at a time on a bit-packed grid
+};
+
+// How JPSPlan searches for a path
+enum JPSSearchMode{
+    SEARCH_FORWARD,     // jump point search from scratch on every call
+    SEARCH_INCREMENTAL, // D* Lite, repairs the previous search tree
+    SEARCH_BIDIRECTIONAL, // jump point search from both ends at once
+    SEARCH_THETA        // any-angle Lazy Theta*, returns nearly taut paths
+};
+
+// How JPSPlan orders its open list
+enum JPSQueueMode{
+    QUEUE_HEAP,     // binary heap on the exact f-cost
+    QUEUE_BUCKET    // one bucket per integer f-cost, O(1) push / pop
+};
+
+// How JPSPlan checks line of sight when simplifying paths
+enum JPSLosMode{
+    LOS_BRESENHAM,  // walk the cells along the line (isBlocked)
+    LOS_DISTANCE    // jump along a distance field, with a margin
+};
+
 class JPSPlan{
 
 public:
     JPSPlan();
     
     void set_occ_value(double x);
+    void set_cost_threshold(int threshold, bool unknown_blocked = true);
+    void set_scan_mode(JPSScanMode mode);
+    void set_queue_mode(JPSQueueMode mode);
+    void set_search_mode(JPSSearchMode mode);
+    void set_los_mode(JPSLosMode mode);
+    void set_los_margin(int cells);
+    void set_landmarks(const std::shared_ptr<const JPSLandmarks>& lm);
+    void set_epsilon_schedule(double eps_start, double eps_step);
+    void set_budget(double max_time, int max_expansions);
     void set_start(int x, int y);
     void set_destination(int x, int y);
     void set_map(unsigned char* map, int sizeX, int sizeY, 
                  double originX, double originY, double resolution);
+    void update_map(int x0, int xn, int y0, int yn);
     void JPS();
 
     std::vector<Eigen::Vector2d> getPath(bool simplify = true);
+    std::vector<Eigen::Vector2d> getPathTo(int x, int y, bool simplify = true);
+    int multiGoalSearch(const std::vector<Eigen::Vector2i>& goals, std::vector<int>& costs,
+                        int max_cost = -1);
+    int nearestFree(int x, int y, int max_radius, std::vector<Eigen::Vector2i>& cells);
+    int nearestReached(int x, int y, int min_radius, int max_radius, 
+                       std::vector<Eigen::Vector2i>& cells);
     std::vector<Eigen::Vector2d> simplifyPath(const std::vector<Eigen::Vector2d>& path);
+    void cachePath(const std::vector<Eigen::Vector2d>& path);
+    bool reusePath(std::vector<Eigen::Vector2d>& path, double tolerance, int max_reuses = 0);
+    void clearPathCache();
     bool worldToMap(double x, double y, unsigned int& mx, unsigned int& my);
     void mapToWorld(unsigned int mx, unsigned int my, double& x, double& y);
 
+    // number of nodes pushed onto / popped off the open list by the last
+    // call to JPS()
+    int get_num_pushes() const { return numPushes; }
+    int get_num_expansions() const { return numExpansions; }
+    JPSStats get_stats() const;
+
+#ifdef JPS_TRACE
+    // cells expanded by the last call to JPS() in the order they were
+    // popped, in world coordinates. Only the jump point searches record
+    // them, and only when built with JPS_TRACE.
+    std::vector<Eigen::Vector2d> getTrace();
+#endif
+
+    // true if the cell is blocked for the search (see set_cost_threshold)
+    bool is_cell_blocked(int x, int y) const { return blocked(y*sizeX + x); }
+
+    // blocked flag of every cost value (256 entries), for what is built
+    // over the same map (see JPSLandmarks, HPAGraph::set_blocked_rule)
+    const uint8_t* get_blocked_rule() const { return blockedLut; }
+
+    // true if the last call to JPS() ran out of budget (or found the 
+    // destination unreachable) and getPath leads to the expanded cell
+    // closest to the destination instead, see set_budget
+    bool is_partial() const { return partialPath; }
+
+    // heuristic weight of the search which found the path of the last 
+    // call to JPS(), 0 if there is no complete path
+    double get_epsilon() const { return goalInd >= 0 && !partialPath ? pathEps : 0; }
 
 private:
 
@@ -48,26 +134,271 @@ private:
     double manhattan_distance(int x, int y);
     double octile_dist(int x, int y);
     double euclidean_dist(int x, int y);
+    double heuristic(int x, int y);
 
     void add_to_queue(int x, int y, int dirx, int diry, double cost);
+    void run_search();
+    void begin_search();
+    void seed_search();
+    int expand_next();
     bool explore_straight(const JPSNode_t& start);
     bool explore_diagonal(const JPSNode_t& start);
 
+    // JPS+ (see JPSPlus.cpp)
+    bool cell_blocked(int x, int y) const;
+    bool straight_forced(int x, int y, int dirx, int diry) const;
+    bool diagonal_jump(int x, int y, int dirx, int diry) const;
+    int next_jump_dist(int x, int y, int dirx, int diry) const;
+    void build_jump_tables();
+    void update_straight_row(int y);
+    void update_straight_col(int x);
+    void update_diagonals(int r0, int r1, int c0, int c1);
+    void update_jump_tables(int x0, int xn, int y0, int yn);
+    bool explore_straight_plus(const JPSNode_t& start);
+    bool explore_diagonal_plus(const JPSNode_t& start);
+
+    // bidirectional search (see JPSBidirectional.cpp)
+    void swap_direction();
+    void join_bidirectional(int meet);
+    void bidirectional_search();
+
+    // line of sight distance field (see JPSLineOfSight.cpp)
+    void los_transform(int x0, int xn, int y0, int yn);
+    void build_los_field();
+    void update_los_field(int x0, int xn, int y0, int yn);
+    bool los_segment_blocked(double ax, double ay, double bx, double by) const;
+    bool los_blocked(const Eigen::Vector2d& p1, const Eigen::Vector2d& p2);
+
+    // path reuse (see JPSPathCache.cpp)
+    void mark_cache_dirty(int x0, int xn, int y0, int yn);
+
+    // anytime weighted search (see JPSAnytime.cpp)
+    bool out_of_budget(double elapsed, int expansions) const;
+    void anytime_search();
+
+    // any-angle search (see JPSTheta.cpp)
+    double theta_heuristic(int ind) const;
+    bool theta_can_move(int a, int b) const;
+    void theta_set_vertex(int ind);
+    void theta_search();
+
+    // incremental search (see JPSIncremental.cpp)
+    double inc_cost(int x, int y, int dx, int dy) const;
+    double inc_heuristic(int ind) const;
+    void inc_key(int ind, double& k1, double& k2) const;
+    void inc_push(int ind);
+    void inc_update_vertex(int ind);
+    void inc_compute();
+    void build_incremental(int start, int goal);
+    void update_incremental(int x0, int xn, int y0, int yn);
+    void extract_incremental_path(int start, int goal);
+    void incremental_search();
+
+    // block-based scanning (see JPSBlock.cpp)
+    void build_block_bits();
+    void set_block_bit(int x, int y, bool blocked);
+    void update_block_bits(int x0, int xn, int y0, int yn);
+    int scan_block_line(const uint64_t* line, const uint64_t* sideA, const uint64_t* sideB,
+                        int words, int s, int dir, bool& is_wall) const;
+    bool explore_straight_block(const JPSNode_t& start);
+
+    static int dir_index(int dirx, int diry){
+        static const int lut[9] = {0, 1, 2, 3, -1, 4, 5, 6, 7};
+        return lut[(dirx+1)*3 + (diry+1)];
+    }
+
+    // blocked cells (see set_cost_threshold)
+    bool blocked(int ind) const { return blockedMask[ind]; }
+    // same for a cell that may lie outside the map, which counts as 
+    // blocked (like cell_blocked for the JPS+ tables)
+    bool blocked_xy(int x, int y) const {
+        return x < 0 || y < 0 || x >= sizeX || y >= sizeY || blockedMask[y*sizeX + x];
+    }
+    void set_blocked_rule();
+    void build_blocked_mask();
+    void update_blocked_mask(int x0, int xn, int y0, int yn);
+    void drop_stale_landmarks(int x0, int xn, int y0, int yn);
+
+    std::vector<Eigen::Vector2d> finish_path(std::vector<Eigen::Vector2d> ret, bool simplify);
+
     bool bresenham(unsigned int abs_da, unsigned int abs_db, int error_b, int offset_a,
         int offset_b, unsigned int offset, unsigned int max_range, unsigned int& term);
     bool isBlocked(const Eigen::Vector2d& p1, const Eigen::Vector2d& p2, 
                     double max_range=1e6, bool map_coords=true);
 
 
-    std::map<int, bool> closedSet;
-    std::map<int, int> parents;
+    // dense search state, one entry per grid cell (sizeX*sizeY). Entries
+    // are only valid when their stamp matches the current generation, so
+    // starting a new search never has to clear or reallocate the buffers
+    bool is_closed(int ind) const { return closedSet[ind] == generation; }
+    void ring_cells(int x, int y, int r, bool reached, std::vector<Eigen::Vector2i>& cells) const;
+    void set_closed(int ind) { closedSet[ind] = generation; }
+    int get_parent(int ind) const { return parentGen[ind] == generation ? parents[ind] : -1; }
+    bool is_target(int ind) const {
+        return ind == destY*sizeX + destX || (biActive && otherParentGen[ind] == generation);
+    }
+    void set_parent(int ind, int parent);
+    void set_parent(int ind, int parent, double g);
+    void resize_buffers(int cells);
+
+    void push_node(const JPSNode_t& node);
+    JPSNode_t pop_node();
+    bool queue_empty() const;
+    void clear_queue();
+
+    std::vector<uint32_t> closedSet;
+    std::vector<uint32_t> parentGen;
+    std::vector<int> parents;
+    std::vector<double> parentCost;
+    uint32_t generation;
 
     unsigned char* _map;
 
     int sizeX, sizeY, startX, startY, destX, destY, goalInd;
     double occupied_val, originX, originY, resolution;
 
-    std::priority_queue<JPSNode_t, std::deque<JPSNode_t>, Compare> q;
+    // which costs count as blocked: exactly occupied_val, or every cost
+    // from costThreshold up (costThreshold > 0) with unknown cells only
+    // if unknownBlocked. blockedLut holds the rule per cost value and 
+    // blockedMask its result for every cell of the map, refreshed by 
+    // set_map / update_map so the searches never look at the costs.
+    int costThreshold;
+    bool unknownBlocked;
+    uint8_t blockedLut[256];
+    std::vector<uint8_t> blockedMask;
+
+    JPSScanMode scanMode;
+
+    // true if the precomputed structure of the current scan mode (JPS+ 
+    // tables or block bits) matches the map
+    bool tablesValid;
+
+    // JPS+ state: snapshot of the blocked cells the tables were built 
+    // from and, per cell and direction, the distance to the next jump 
+    // point (> 0) or minus the number of free cells before a wall (<= 0)
+    std::vector<uint8_t> tableOcc;
+    std::vector<int> jumpDist;
+
+    // block state: blocked bits of every row, and of every column (the 
+    // transposed grid) for vertical scans. Each line has one padding bit
+    // on both ends and there is a padding line on both sides of the map,
+    // all of them set so the map border acts like a wall.
+    int rowWords, colWords;
+    std::vector<uint64_t> rowBits;
+    std::vector<uint64_t> colBits;
+
+    JPSSearchMode searchMode;
+
+    // line of sight state: per cell, Chebyshev distance to the closest
+    // blocked cell (capped), and the clearance margin in cells every
+    // checked segment must keep from them
+    JPSLosMode losMode;
+    int losMargin;
+    bool losValid;
+    std::vector<uint8_t> losDist;
+
+    // Lazy Theta* state: cost-to-come of every cell with a parent in the
+    // current generation, and the open list as a min-heap on f-cost
+    struct JPSThetaEntry{
+        double f;
+        int ind;
+    };
+    std::vector<double> thetaG;
+    std::vector<JPSThetaEntry> thetaQ;
+
+    static bool theta_greater(const JPSThetaEntry& a, const JPSThetaEntry& b){
+        return a.f > b.f;
+    }
+
+    // cached path in grid cell coordinates, the destination it leads to
+    // and, per segment, whether its cells may have changed since it was
+    // last checked, and how often it was reused
+    std::vector<Eigen::Vector2d> cachePoints;
+    std::vector<uint8_t> cacheDirty;
+    int cacheDest, cacheReuses;
+
+    // anytime search settings (see set_epsilon_schedule / set_budget),
+    // the weight currently applied by heuristic(), and the result of the
+    // last search: whether the path is partial, the weight it was found
+    // with and the expanded cell with the lowest heuristic so far
+    double epsStart, epsStep, maxTime;
+    int maxExpansions;
+    double weight;
+    bool partialPath;
+    double pathEps;
+    int closestInd;
+    double closestH;
+    std::vector<int> anytimeChain;
+
+    // cells in breadth first order for multiGoalSearch
+    std::vector<int> bfsQueue;
+
+    // optional landmark distance fields of the static map, dropped as
+    // soon as update_map reports a cell they consider blocked as free
+    std::shared_ptr<const JPSLandmarks> landmarks;
+    JPSQueueMode queueMode;
+
+    // counters of the last search (see get_stats) and, when tracing, 
+    // the cells it expanded
+    int numPushes, numExpansions, numScanned, numClosedHits;
+    double searchTime;
+#ifdef JPS_TRACE
+    std::vector<int> traceCells;
+#endif
+
+    // open list kept as a binary heap over a vector (see Compare) so its
+    // storage is reused from one search to the next
+    std::vector<JPSNode_t> q;
+
+    // bucket open list: nodes with f-cost in [k, k+1) go to buckets[k]. 
+    // Only the cell index, direction and cost-to-come are stored, the 
+    // rest of the node is recovered when it is popped. The f-cost isn't
+    // monotone (a diagonal step costs 1 but can lower the heuristic by 
+    // 2) so bucketMin moves back when a cheaper node comes in.
+    struct JPSBucketNode{
+        int ind;
+        signed char dirx, diry;
+        double cost;
+    };
+    std::vector<std::vector<JPSBucketNode> > buckets;
+    int bucketMin, bucketMax, bucketCount;
+
+    // the other direction of a bidirectional search, swapped with the 
+    // closed set, parents and open list above (and start with 
+    // destination) each time the search changes direction. While the
+    // search runs, any cell with a parent in the other direction counts
+    // as a target (see is_target).
+    bool biActive;
+    std::vector<uint32_t> otherClosed;
+    std::vector<uint32_t> otherParentGen;
+    std::vector<int> otherParents;
+    std::vector<double> otherParentCost;
+    std::vector<JPSNode_t> otherQ;
+    std::vector<std::vector<JPSBucketNode> > otherBuckets;
+    int otherBucketMin, otherBucketMax, otherBucketCount;
+
+    // incremental (D* Lite) state. The search runs backwards from the 
+    // goal, so g / rhs are costs-to-goal and stay valid when the start
+    // moves; km offsets the keys of queued cells by how far the start
+    // has moved since they were queued. incOcc is the snapshot of the 
+    // blocked cells the tree was built on and incChanged the cells that
+    // changed since the last search (see update_map).
+    struct JPSIncEntry{
+        double k1, k2;
+        int ind;
+    };
+    bool incValid;
+    int incStart, incGoal;
+    double km;
+    std::vector<double> incG, incRhs, incK1, incK2;
+    std::vector<uint8_t> incOcc, incOpen;
+    std::vector<int> incChanged;
+    std::vector<JPSIncEntry> incQ;
+
+    // min-heap order on the (k1, k2) keys
+    static bool inc_greater(const JPSIncEntry& a, const JPSIncEntry& b){
+        return a.k1 > b.k1 || (a.k1 == b.k1 && a.k2 > b.k2);
+    }
 
 };
 
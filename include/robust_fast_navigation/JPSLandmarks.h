@@ -0,0 +1,65 @@
+#ifndef JPS_LANDMARKS_H
+#define JPS_LANDMARKS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**********************************************************************
+  Differential (ALT) heuristic for JPSPlan on a static map. For a few
+  landmark cells the grid distance to every other cell is precomputed,
+  with the same cost model as the jump point search (8-connected, every
+  step costs 1). By the triangle inequality |d(L,a) - d(L,b)| is then a
+  lower bound on the distance between a and b, and two cells of which
+  only one can be reached from a landmark can't be connected at all.
+
+  The fields only depend on which cells are blocked under the rule of
+  the JPSPlan they are for (see JPSPlan::get_blocked_rule), so they are
+  computed once per map (typically in the background) and can be saved
+  next to the map and loaded again on the next start.
+***********************************************************************/
+class JPSLandmarks{
+
+public:
+    JPSLandmarks();
+
+    void compute(const unsigned char* map, int sizeX, int sizeY,
+                 const uint8_t* blocked_rule, int num_landmarks);
+    bool save(const std::string& file) const;
+    bool load(const std::string& file, const unsigned char* map, int sizeX,
+              int sizeY, const uint8_t* blocked_rule);
+
+    double lower_bound(int a, int b) const;
+    bool was_blocked(int ind) const { return occ[ind]; }
+    bool same_rule(const uint8_t* blocked_rule) const;
+    int size_x() const { return sizeX; }
+    int size_y() const { return sizeY; }
+    int num_landmarks() const { return (int) landmarks.size(); }
+
+    static std::string file_name(const unsigned char* map, int sizeX, int sizeY,
+                                 const uint8_t* blocked_rule);
+
+    // distance stored for cells which can't be reached from a landmark.
+    // Maps with a cell this many steps away from another get no fields.
+    static const uint16_t UNREACHABLE = 0xffff;
+
+private:
+
+    bool bfs(int source, uint16_t* dist) const;
+    static uint64_t map_hash(const std::vector<uint8_t>& occ);
+
+    int sizeX, sizeY;
+    uint64_t hash;
+
+    // blocked flag of every cost value (see JPSPlan::get_blocked_rule),
+    // and snapshot of the blocked cells the fields were computed on
+    uint8_t rule[256];
+    std::vector<uint8_t> occ;
+
+    // landmark cells, and their distance fields one after the other
+    std::vector<int> landmarks;
+    std::vector<uint16_t> dist;
+
+};
+
+#endif
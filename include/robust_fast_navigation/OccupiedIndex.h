@@ -0,0 +1,78 @@
+#ifndef OCCUPIED_INDEX_H
+#define OCCUPIED_INDEX_H
+
+#include <vector>
+#include <cstdint>
+#include <Eigen/Core>
+
+/**********************************************************************
+  Set of the occupied cells of a grid, in world coordinates, kept up to
+  date through the regions reported as changed instead of scanning the
+  whole grid every time it is needed. Every indexed cell has one point
+  (its center, z = 0, as the corridor generation expects), removed in
+  O(1) by moving the last point into its place, so the order of the
+  points is arbitrary.
+
+  Occupied means a cost between the two values given to set_occ_range,
+  by default the inscribed and lethal costs of a costmap_2d grid (the
+  cells corridor::getOccupied returns).
+
+  Cells inside an obstacle can't define a halfspace of the corridor
+  polytopes as long as the cells around them are there, so the index
+  can be limited to the boundary of the obstacles (set_boundary), and
+  thinned out to one point per square block of cells (set_decimation).
+***********************************************************************/
+class OccupiedIndex{
+
+public:
+    OccupiedIndex();
+
+    void set_occ_range(int low, int high);
+    void set_boundary(int connectivity);
+    void set_decimation(int cells);
+    void set_map(const unsigned char* map, int sizeX, int sizeY,
+                 double originX, double originY, double resolution);
+    void update_map(int x0, int xn, int y0, int yn);
+
+    // indexed cell centers, valid until the next set_map / update_map
+    const std::vector<Eigen::Vector3d>& points() const { return pts; }
+    int size() const { return (int) pts.size(); }
+
+private:
+
+    bool occupied(int x, int y) const { 
+        unsigned char c = _map[y*sizeX + x];
+        return c >= occLow && c <= occHigh; 
+    }
+    bool indexed(int x, int y) const;
+    int block_of(int x, int y) const { return (y/decimation)*blocksX + x/decimation; }
+    void add_cell(int x, int y);
+    void remove_cell(int x, int y);
+    void refresh(int x0, int xn, int y0, int yn);
+    void build();
+
+    const unsigned char* _map;
+    int sizeX, sizeY;
+    double originX, originY, resolution;
+    int occLow, occHigh;
+
+    // 0 to index every occupied cell, 4 / 8 to only index occupied cells
+    // with a free 4 / 8-neighbor, and the side of the blocks sharing one
+    // point
+    int connectivity;
+    int decimation;
+    int blocksX;
+
+    // per cell, whether it is indexed. Per block, how many of its cells
+    // are, the cell its point is at and the index of that point in pts
+    // (-1 if it has none). Per point, the block it belongs to.
+    std::vector<uint8_t> member;
+    std::vector<int> count;
+    std::vector<int> repCell;
+    std::vector<int> slot;
+    std::vector<int> blocks;
+    std::vector<Eigen::Vector3d> pts;
+
+};
+
+#endif
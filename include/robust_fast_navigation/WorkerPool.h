@@ -0,0 +1,57 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+/**********************************************************************
+  Threads kept alive across calls for the parallel parts of a planning
+  cycle (corridor segments, failsafe searches), so a replan doesn't
+  start and join threads every time. run hands out worker ids 0..n-1,
+  worker 0 being the calling thread, and returns once all of them are
+  done. The job is a plain function and a pointer, nothing is allocated
+  per run once the pool has grown to the number of workers asked for.
+
+  One run at a time: run must not be called from a job or from two
+  threads at once.
+***********************************************************************/
+class WorkerPool{
+
+public:
+    typedef void (*Job)(void* arg, int worker);
+
+    WorkerPool();
+    ~WorkerPool();
+
+    // threads of the pool, besides the calling one
+    int size() const { return (int) threads.size(); }
+    void reserve(int workers);
+
+    void run(int workers, Job job, void* arg);
+
+    // run f(worker) for any callable f, kept by the caller for the run
+    template <class F>
+    void run(int workers, F& f){
+        run(workers, [](void* arg, int worker){ (*(F*) arg)(worker); }, &f);
+    }
+
+private:
+    void loop(int worker, unsigned long seen);
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    // current job, its number of workers, a counter bumped by every run
+    // (so a thread knows it has a new job) and the pool workers still busy
+    Job job;
+    void* arg;
+    int workers;
+    unsigned long round;
+    int busy;
+    bool stop;
+};
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef CORRIDOR_H
 #define CORRIDOR_H
 
+#include <atomic>
+#include <thread>
 #include <iostream>
+#include <algorithm>
 
 #include <gcopter/firi.hpp>
 #include <gcopter/geo_utils.hpp>
@@ -16,9 +19,276 @@
 #include <decomp_geometry/geometric_utils.h>
 
 #include <robust_fast_navigation/utils.h>
+#include <robust_fast_navigation/WorkerPool.h>
 
 namespace corridor{
 
+    // Points bucketed into a uniform grid over x / y for the box queries
+    // of convexCover. The points are stored bucket by bucket, row after
+    // row, so a box only has to test one contiguous span per grid row it
+    // overlaps instead of every point. It finds the same points as 
+    // testing them all, in bucket order (FIRI doesn't depend on it).
+    // A grid built again keeps its buffers.
+    class PointGrid{
+    public:
+        PointGrid() : size(1.0), nx(0), ny(0) {}
+
+        PointGrid(const std::vector<Eigen::Vector3d>& points, double cell){
+            build(points, cell);
+        }
+
+        void build(const std::vector<Eigen::Vector3d>& points, double cell){
+            
+            nx = ny = 0;
+            if (points.empty())
+                return;
+
+            Eigen::Vector2d hi = points[0].head<2>();
+            lo = hi;
+            for(const Eigen::Vector3d& p : points){
+                lo = lo.cwiseMin(p.head<2>());
+                hi = hi.cwiseMax(p.head<2>());
+            }
+
+            // keep the number of buckets in line with the number of points
+            size = std::max(cell, 1e-6);
+            Eigen::Vector2d ext = hi - lo;
+            while ((ext[0]/size + 1)*(ext[1]/size + 1) > 4.0*points.size() + 64)
+                size *= 2;
+            nx = (int) (ext[0]/size) + 1;
+            ny = (int) (ext[1]/size) + 1;
+
+            cellOf.resize(points.size());
+            start.assign(nx*ny + 1, 0);
+            for(size_t i = 0; i < points.size(); i++){
+                cellOf[i] = bucket_y(points[i][1])*nx + bucket_x(points[i][0]);
+                start[cellOf[i] + 1]++;
+            }
+            for(int c = 0; c < nx*ny; c++)
+                start[c+1] += start[c];
+
+            fill.assign(start.begin(), start.end() - 1);
+            pts.resize(points.size());
+            for(size_t i = 0; i < points.size(); i++)
+                pts[fill[cellOf[i]]++] = points[i];
+        }
+
+        // points strictly inside the box bd * [p; 1] < 0 (see convexCover)
+        void query(const Eigen::Matrix<double, 6, 4>& bd, std::vector<Eigen::Vector3d>& out) const{
+            out.clear();
+            if (nx == 0)
+                return;
+
+            int x0 = bucket_x(bd(1, 3)), x1 = bucket_x(-bd(0, 3));
+            int y0 = bucket_y(bd(3, 3)), y1 = bucket_y(-bd(2, 3));
+            for(int y = y0; y <= y1; y++){
+                for(int k = start[y*nx + x0]; k < start[y*nx + x1 + 1]; k++){
+                    if ((bd.leftCols<3>() * pts[k] + bd.rightCols<1>()).maxCoeff() < 0.0)
+                        out.push_back(pts[k]);
+                }
+            }
+        }
+
+    private:
+        int bucket_x(double x) const { 
+            return std::min(std::max((int) std::floor((x - lo[0])/size), 0), nx-1); 
+        }
+        int bucket_y(double y) const { 
+            return std::min(std::max((int) std::floor((y - lo[1])/size), 0), ny-1); 
+        }
+
+        Eigen::Vector2d lo;
+        double size;
+        int nx, ny;
+
+        // index in pts of the first point of every bucket (row by row), 
+        // and the points sorted by bucket
+        std::vector<int> start;
+        std::vector<Eigen::Vector3d> pts;
+
+        // scratch of build
+        std::vector<int> cellOf, fill;
+    };
+
+    // Polytopes of the last corridor, kept for the next one (see 
+    // convexCover). A polytope is used again for a segment if it still
+    // contains the segment, lies within the map and has no obstacle point
+    // inside; of those, the one built for the nearest segment is taken.
+    class CorridorCache{
+    public:
+        struct Entry{
+            Eigen::Vector3d a, b;
+            Eigen::Matrix<double, 6, 4> bd;
+            Eigen::MatrixX4d hp;
+            bool gap;
+        };
+
+        CorridorCache() : numLast(0), numNext(0), numReused(0) {}
+
+        void clear(){ 
+            numLast = numNext = 0; 
+            numReused = 0; 
+        }
+
+        // number of polytopes of the last corridor used in the current one
+        int reused() const { return numReused; }
+
+        void begin(){ 
+            numNext = 0; 
+            numReused = 0; 
+        }
+
+        // a valid polytope of the last corridor for segment a -> b, null if 
+        // there is none. gap polytopes (see convexCover) only stand for gaps.
+        const Entry* find(const Eigen::Vector3d& a, const Eigen::Vector3d& b, bool gap,
+                          const PointGrid& grid, const Eigen::Vector3d& lowCorner,
+                          const Eigen::Vector3d& highCorner, double eps){
+
+            const Eigen::Vector4d ah(a(0), a(1), a(2), 1.0);
+            const Eigen::Vector4d bh(b(0), b(1), b(2), 1.0);
+            const Eigen::Vector3d mid = 0.5 * (a + b);
+
+            order.clear();
+            for(int i = 0; i < numLast; i++){
+                const Entry& e = last[i];
+                if (e.gap != gap || e.hp.lazyProduct(ah).maxCoeff() > -eps || e.hp.lazyProduct(bh).maxCoeff() > -eps)
+                    continue;
+
+                // box of the polytope outside of the map, obstacles may be missing
+                if (-e.bd(0, 3) > highCorner(0) || e.bd(1, 3) < lowCorner(0) ||
+                    -e.bd(2, 3) > highCorner(1) || e.bd(3, 3) < lowCorner(1))
+                    continue;
+
+                order.push_back(std::make_pair((0.5 * (e.a + e.b) - mid).squaredNorm(), i));
+            }
+            std::sort(order.begin(), order.end());
+
+            for(const std::pair<double, int>& o : order){
+                const Entry& e = last[o.second];
+                grid.query(e.bd, pts);
+
+                bool free = true;
+                for(size_t j = 0; free && j < pts.size(); j++)
+                    free = e.hp.lazyProduct(Eigen::Vector4d(pts[j](0), pts[j](1), pts[j](2), 1.0)).maxCoeff() >= -eps;
+
+                if (free){
+                    numReused++;
+                    return &e;
+                }
+            }
+
+            return nullptr;
+        }
+
+        // keep a polytope of the current corridor for the next one. The 
+        // entries are written over in place, so a corridor like one of the
+        // two before it doesn't allocate.
+        void add(const Eigen::Vector3d& a, const Eigen::Vector3d& b, 
+                 const Eigen::Matrix<double, 6, 4>& bd, const Eigen::MatrixX4d& hp, bool gap){
+            if (numNext == (int) next.size())
+                next.emplace_back();
+
+            Entry& e = next[numNext++];
+            e.a = a;
+            e.b = b;
+            e.bd = bd;
+            e.hp = hp;
+            e.gap = gap;
+        }
+
+        // the current corridor is complete, keep it for the next one
+        void finish(){ 
+            last.swap(next); 
+            numLast = numNext;
+            numNext = 0; 
+        }
+
+    private:
+        // the first numLast / numNext entries are in use
+        std::vector<Entry> last, next;
+        int numLast, numNext;
+        int numReused;
+
+        // scratch of find
+        std::vector<std::pair<double, int> > order;
+        std::vector<Eigen::Vector3d> pts;
+    };
+
+    // FIRI of one convexCover segment in workspace ws, with the LP order
+    // reseeded first so the result doesn't depend on what ran before it
+    // on the same thread
+    inline bool segmentFIRI(const Eigen::Matrix<double, 6, 4> &bd,
+                            const std::vector<Eigen::Vector3d> &pcs,
+                            const Eigen::Vector3d &a,
+                            const Eigen::Vector3d &b,
+                            Eigen::MatrixX4d &hp,
+                            firi::MVIEWorkspace &ws,
+                            const int iterations = 4)
+    {
+        Eigen::Map<const Eigen::Matrix<double, 3, -1, Eigen::ColMajor>> pc(
+            pcs.empty() ? nullptr : pcs[0].data(), 3, pcs.size());
+
+        sdlp::rand_engine().seed(std::mt19937_64::default_seed);
+        return firi::firi(bd, pc, a, b, hp, ws, iterations);
+    }
+
+    // Same as segmentFIRI, but for points and a path in the xy plane: 
+    // the polygon is found with planar FIRI and given back the z faces 
+    // of the box, so it is the same kind of polytope the 3D version
+    // returns and can go straight to GCOPTER.
+    inline bool segmentFIRI2d(const Eigen::Matrix<double, 6, 4> &bd,
+                              const std::vector<Eigen::Vector3d> &pcs,
+                              const Eigen::Vector3d &a,
+                              const Eigen::Vector3d &b,
+                              Eigen::MatrixX4d &hp,
+                              firi::MVIEWorkspace &ws,
+                              const int iterations = 4)
+    {
+        Eigen::Map<const Eigen::Matrix<double, 2, -1, Eigen::ColMajor>, 0, Eigen::OuterStride<3>> pc(
+            pcs.empty() ? nullptr : pcs[0].data(), 2, pcs.size());
+
+        Eigen::Matrix<double, 4, 3> bd2;
+        bd2 << bd.block<4, 2>(0, 0), bd.block<4, 1>(0, 3);
+
+        sdlp::rand_engine().seed(std::mt19937_64::default_seed);
+        if (!firi::firi2d(bd2, pc, a.head<2>(), b.head<2>(), ws, iterations))
+            return false;
+
+        const Eigen::Block<Eigen::MatrixX3d> hp2 = ws.iter2.result();
+        hp.setZero(hp2.rows() + 2, 4);
+        hp.block(0, 0, hp2.rows(), 2) = hp2.leftCols<2>();
+        hp.block(0, 3, hp2.rows(), 1) = hp2.rightCols<1>();
+        hp.bottomRows<2>() = bd.bottomRows<2>();
+        return true;
+    }
+
+    // Buffers of convexCover, to be kept by the caller across calls: the
+    // FIRI workspace of every worker and the segments, points and 
+    // polytopes of the last corridor. Computing the same corridor again
+    // in a workspace allocates nothing (nor does the cache), a similar 
+    // one only for the polytopes that changed size.
+    struct CorridorWorkspace{
+        std::vector<firi::MVIEWorkspace> workers;
+        PointGrid grid;
+        std::vector<Eigen::Vector3d> path3d, as, bs;
+        std::vector<Eigen::Matrix<double, 6, 4>> bds, hbds;
+        std::vector<std::vector<Eigen::Vector3d>> pcs;
+        std::vector<Eigen::MatrixX4d> hps, gaps;
+        std::vector<char> ok;
+        std::vector<int> todo;
+    };
+
+    // The polytopes of the segments are independent, so with threads > 1
+    // they are computed in parallel, and the polytopes filling the gaps
+    // between them in a sequential pass afterwards. The result is the 
+    // same for any number of threads. With planar set, the path and the
+    // points have to lie in a plane of constant z, and the polytopes are
+    // found in 2D (see segmentFIRI2d). With a cache, polytopes of the 
+    // last corridor that are still valid for a segment are used instead
+    // of running FIRI again (see CorridorCache). Without a workspace,
+    // every call allocates its own buffers (see CorridorWorkspace). The
+    // workers run in pool, without one they are threads started and 
+    // joined by the call.
     inline bool convexCover(const std::vector<Eigen::Vector3d> &path,
                             const std::vector<Eigen::Vector3d> &points,
                             const Eigen::Vector3d &lowCorner,
@@ -26,9 +296,35 @@ namespace corridor{
                             const double &progress,
                             const double &range,
                             std::vector<Eigen::MatrixX4d> &hpolys,
-                            const double eps = 1.0e-6)
+                            const double eps = 1.0e-6,
+                            const int threads = 1,
+                            const bool planar = false,
+                            CorridorCache *cache = nullptr,
+                            CorridorWorkspace *workspace = nullptr,
+                            WorkerPool *pool = nullptr)
     {
-        hpolys.clear();
+        CorridorWorkspace local;
+        CorridorWorkspace &cw = workspace ? *workspace : local;
+
+        // the polytopes are written over those of the last call
+        int nPolys = 0;
+        auto emit = [&](const Eigen::MatrixX4d &hp)
+        {
+            if (nPolys == (int)hpolys.size())
+            {
+                hpolys.emplace_back(hp);
+            }
+            else
+            {
+                hpolys[nPolys] = hp;
+            }
+            nPolys++;
+        };
+
+        if (cache)
+        {
+            cache->begin();
+        }
         const int n = path.size();
         Eigen::Matrix<double, 6, 4> bd = Eigen::Matrix<double, 6, 4>::Zero();
         bd(0, 0) = 1.0;
@@ -38,11 +334,15 @@ namespace corridor{
         bd(4, 2) = 1.0;
         bd(5, 2) = -1.0;
 
-        Eigen::MatrixX4d hp, gap;
+        // segments of at most progress length, their boxes and points
         Eigen::Vector3d a, b = path[0];
-        std::vector<Eigen::Vector3d> valid_pc;
-        std::vector<Eigen::Vector3d> bs;
-        valid_pc.reserve(points.size());
+        std::vector<Eigen::Vector3d> &as = cw.as, &bs = cw.bs;
+        std::vector<Eigen::Matrix<double, 6, 4>> &bds = cw.bds;
+        std::vector<std::vector<Eigen::Vector3d>> &pcs = cw.pcs;
+        as.clear();
+        bs.clear();
+        bds.clear();
+        cw.grid.build(points, range / 4.0);
         for (int i = 1; i < n;)
         {
             a = b;
@@ -55,6 +355,7 @@ namespace corridor{
                 b = path[i];
                 i++;
             }
+            as.emplace_back(a);
             bs.emplace_back(b);
 
             bd(0, 3) = -std::min(std::max(a(0), b(0)) + range, highCorner(0));
@@ -63,38 +364,133 @@ namespace corridor{
             bd(3, 3) = +std::max(std::min(a(1), b(1)) - range, lowCorner(1));
             bd(4, 3) = -std::min(std::max(a(2), b(2)) + range, highCorner(2));
             bd(5, 3) = +std::max(std::min(a(2), b(2)) - range, lowCorner(2));
+            bds.emplace_back(bd);
 
-            valid_pc.clear();
-            for (const Eigen::Vector3d &p : points)
+            // point lists and polytopes of longer corridors are kept
+            if (pcs.size() < bds.size())
             {
-                if ((bd.leftCols<3>() * p + bd.rightCols<1>()).maxCoeff() < 0.0)
-                {
-                    valid_pc.emplace_back(p);
-                }
+                pcs.emplace_back();
             }
-            Eigen::Map<const Eigen::Matrix<double, 3, -1, Eigen::ColMajor>> pc(valid_pc[0].data(), 3, valid_pc.size());
+            cw.grid.query(bd, pcs[bds.size() - 1]);
+        }
+
+        const int m = bds.size();
+        if ((int)cw.hps.size() < m)
+        {
+            cw.hps.resize(m);
+            cw.gaps.resize(m);
+        }
+        std::vector<Eigen::MatrixX4d> &hps = cw.hps;
+        std::vector<char> &ok = cw.ok;
+        std::vector<Eigen::Matrix<double, 6, 4>> &hbds = cw.hbds;
+        std::vector<int> &todo = cw.todo;
+        ok.assign(m, 0);
+        hbds.assign(bds.begin(), bds.end());
+        todo.clear();
+        for (int k = 0; k < m; k++)
+        {
+            const CorridorCache::Entry *e = cache ? 
+                cache->find(as[k], bs[k], false, cw.grid, lowCorner, highCorner, eps) : nullptr;
+            if (e)
+            {
+                hps[k] = e->hp;
+                hbds[k] = e->bd;
+                ok[k] = 1;
+            }
+            else
+            {
+                todo.push_back(k);
+            }
+        }
+
+        const int nTodo = todo.size();
+        const int nWorkers = std::max(1, std::min(threads, nTodo));
+        if ((int)cw.workers.size() < nWorkers)
+        {
+            cw.workers.resize(nWorkers);
+        }
 
-            if (!firi::firi(bd, pc, a, b, hp)){
+        std::atomic<int> next(0);
+        auto segment = planar ? segmentFIRI2d : segmentFIRI;
+        auto worker = [&](int w)
+        {
+            firi::MVIEWorkspace &ws = cw.workers[w];
+            for (int t = next++; t < nTodo; t = next++)
+            {
+                const int k = todo[t];
+                ok[k] = segment(bds[k], pcs[k], as[k], bs[k], hps[k], ws, 4);
+            }
+        };
+
+        if (pool)
+        {
+            pool->run(nWorkers, worker);
+        }
+        else
+        {
+            std::vector<std::thread> started;
+            for (int w = 1; w < nWorkers; w++)
+            {
+                started.emplace_back(worker, w);
+            }
+            worker(0);
+            for (std::thread &t : started)
+            {
+                t.join();
+            }
+        }
+
+        for (int k = 0; k < m; k++)
+        {
+            if (!ok[k])
+            {
                 std::cout << "firi failure :(" << std::endl;
+                hpolys.resize(nPolys);
                 return false;
             }
 
-            if (hpolys.size() != 0)
+            if (k > 0)
             {
-                const Eigen::Vector4d ah(a(0), a(1), a(2), 1.0);
-                if (3 <= ((hp * ah).array() > -eps).cast<int>().sum() +
-                             ((hpolys.back() * ah).array() > -eps).cast<int>().sum())
+                const Eigen::Vector4d ah(as[k](0), as[k](1), as[k](2), 1.0);
+                if (3 <= (hps[k].lazyProduct(ah).array() > -eps).cast<int>().sum() +
+                             (hps[k - 1].lazyProduct(ah).array() > -eps).cast<int>().sum())
                 {
-                    if (!firi::firi(bd, pc, a, a, gap, 1)){
-                        std::cout << "firi failure :(" << std::endl;
-                        return false;
+                    Eigen::MatrixX4d &gap = cw.gaps[k];
+                    const CorridorCache::Entry *e = cache ? 
+                        cache->find(as[k], as[k], true, cw.grid, lowCorner, highCorner, eps) : nullptr;
+                    if (e)
+                    {
+                        gap = e->hp;
+                        cache->add(as[k], as[k], e->bd, gap, true);
+                    }
+                    else
+                    {
+                        if (!segment(bds[k], pcs[k], as[k], as[k], gap, cw.workers[0], 1)){
+                            std::cout << "firi failure :(" << std::endl;
+                            hpolys.resize(nPolys);
+                            return false;
+                        }
+                        if (cache)
+                        {
+                            cache->add(as[k], as[k], bds[k], gap, true);
+                        }
                     }
                         
-                    hpolys.emplace_back(gap);
+                    emit(gap);
                 }
             }
 
-            hpolys.emplace_back(hp);
+            emit(hps[k]);
+            if (cache)
+            {
+                cache->add(as[k], bs[k], hbds[k], hps[k], false);
+            }
+        }
+        hpolys.resize(nPolys);
+
+        if (cache)
+        {
+            cache->finish();
         }
 
         return true;
@@ -478,22 +874,17 @@ namespace corridor{
 
     inline bool createCorridorJPS(
         const std::vector<Eigen::Vector2d>& path, const costmap_2d::Costmap2D& _map,
-        const vec_Vec2f& _obs, std::vector<Eigen::MatrixX4d>& polys){
+        const std::vector<Eigen::Vector3d>& obs3d, std::vector<Eigen::MatrixX4d>& polys,
+        int threads = 1, bool planar = false, CorridorCache* cache = nullptr,
+        CorridorWorkspace* workspace = nullptr, WorkerPool* pool = nullptr){
 
-        polys.clear();
-        std::vector<Eigen::Vector3d> path3d, obs3d;
+        std::vector<Eigen::Vector3d> local;
+        std::vector<Eigen::Vector3d>& path3d = workspace ? workspace->path3d : local;
+        path3d.clear();
         for(Eigen::Vector2d p : path){
             path3d.push_back(Eigen::Vector3d(p[0], p[1], 0));
         }
 
-        // for(Vec2f ob : getPaddedScan(_map, path[0][0], path[0][1], _obs)){
-        //     obs3d.push_back(Eigen::Vector3d(ob[0], ob[1], 0));
-        // }
-
-        for(Vec2f ob : getOccupied(_map)){
-            obs3d.push_back(Eigen::Vector3d(ob[0], ob[1], 0));
-        }
-
         double x = _map.getOriginX();
         double y = _map.getOriginY();
         double w = _map.getSizeInMetersX();
@@ -502,7 +893,7 @@ namespace corridor{
         // ROS_INFO("(%.2f, %.2f) --> (%.2f, %.2f)", x, y, x+w, y+h);
         // exit(0);
         bool status = convexCover(path3d, obs3d, Eigen::Vector3d(x,y,-.1), 
-            Eigen::Vector3d(x+w,y+h,.1),7.0, 5.0, polys);
+            Eigen::Vector3d(x+w,y+h,.1),7.0, 5.0, polys, 1.0e-6, threads, planar, cache, workspace, pool);
 
         if (!status)
             return false;
@@ -510,6 +901,23 @@ namespace corridor{
         shortCut(polys);
         
         return true;
+    }
+
+    inline bool createCorridorJPS(
+        const std::vector<Eigen::Vector2d>& path, const costmap_2d::Costmap2D& _map,
+        const vec_Vec2f& _obs, std::vector<Eigen::MatrixX4d>& polys){
+
+        std::vector<Eigen::Vector3d> obs3d;
+
+        // for(Vec2f ob : getPaddedScan(_map, path[0][0], path[0][1], _obs)){
+        //     obs3d.push_back(Eigen::Vector3d(ob[0], ob[1], 0));
+        // }
+
+        for(Vec2f ob : getOccupied(_map)){
+            obs3d.push_back(Eigen::Vector3d(ob[0], ob[1], 0));
+        }
+
+        return createCorridorJPS(path, _map, obs3d, polys);
 
         // for(int i = 0; i < path.size()-1; i++){
         //     polys.push_back(genPolyJPS(_map, path[i], path[i+1], _obs));
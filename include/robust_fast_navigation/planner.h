@@ -2,8 +2,15 @@
 #define PLANNER_H
 
 #include <string>
+#include <future>
+#include <memory>
 #include <ros/ros.h>
 #include "gcopter/gcopter.hpp"
+#include <robust_fast_navigation/JPS.h>
+#include <robust_fast_navigation/HPAGraph.h>
+#include <robust_fast_navigation/OccupiedIndex.h>
+#include <robust_fast_navigation/WorkerPool.h>
+#include <robust_fast_navigation/corridor.h>
 
 #include <nav_msgs/Path.h>
 #include <nav_msgs/Odometry.h>
@@ -50,7 +57,17 @@ private:
     
     // utilities
     void pubPolys();
-    void projectIntoMap(const Eigen::Vector2d& goal);
+    bool projectIntoMap(Eigen::Vector2d& goal);
+    bool planToHorizon(const Eigen::Vector2d& goal, std::vector<Eigen::Vector2d>& path,
+                       Eigen::Vector2d& horizonGoal);
+    void updateLandmarks(costmap_2d::Costmap2D* map);
+    void getChangedBounds(costmap_2d::Costmap2D* map, int& x0, int& xn, int& y0, int& yn);
+    bool failsafeSearch(int lookInd, unsigned int eX, unsigned int eY,
+                        std::vector<Eigen::Vector2d>& path, Eigen::Vector3d& startPos,
+                        int& stitchInd);
+#ifdef JPS_TRACE
+    void pubJPSTrace();
+#endif
 
     template <int D>
     trajectory_msgs::JointTrajectory convertTrajToMsg(const Trajectory<D> &traj);
@@ -61,9 +78,11 @@ private:
 
     bool _is_init, _started_costmap, _is_goal_set, _is_teleop, _is_goal_reset,
          _plan_once, _simplify_jps, _is_costmap_started, _map_received, 
-         _plan_in_free;
+         _plan_in_free, _landmarks_started, _reuse_jps_path, _jps_unknown_blocked,
+         _corridor_planar, _corridor_reuse;
 
-    std::string _frame_str;
+    std::string _frame_str, _jps_scan_mode, _jps_queue_mode,
+                _jps_search_mode, _jps_los_mode, _jps_landmark_file;
 
     trajectory_msgs::JointTrajectory sentTraj;
     
@@ -72,21 +91,66 @@ private:
     ros::Subscriber laserSub, odomSub, pathSub, goalSub, clickedPointSub, mapSub;
     ros::Publisher trajVizPub, wptVizPub, trajPub, trajPubNoReset, meshPub, intGoalPub,
     edgePub, goalPub, paddedLaserPub, jpsPub, jpsPubFree, jpsPointsPub, currPolyPub, 
-    initPointPub;
+    initPointPub, jpsTracePub;
 
     costmap_2d::Costmap2DROS* local_costmap, *global_costmap;
     std::vector<Eigen::Vector2d> astarPath;
-    std::vector<Eigen::Vector2d> _prev_jps_path;
 
     std::vector<Eigen::MatrixX4d> hPolys;
 
+    // kept across planning cycles so its search buffers are reused
+    JPSPlan _jps;
+
+    // global costmap as of the last planning cycle, its size and origin
+    // (see getChangedBounds)
+    std::vector<unsigned char> _map_snapshot;
+    int _snapshot_size_x;
+    double _snapshot_origin_x, _snapshot_origin_y;
+
+    // abstract graph over the costmap for large maps, routes from it are
+    // refined by _jps inside the horizon
+    HPAGraph _hpa;
+
+    // landmark heuristic fields of the static map, built in the background
+    std::future<std::shared_ptr<const JPSLandmarks> > _landmark_future;
+    std::shared_ptr<const JPSLandmarks> _landmark_fields;
+
+    // occupied cells of the global costmap, patched with the cells that
+    // changed since the last planning cycle
+    OccupiedIndex _occupied;
+
+    // polytopes of the last corridor, used again where still valid
+    corridor::CorridorCache _corridor_cache;
+
+    // buffers of the corridor generation (FIRI workspaces of the workers,
+    // segments and polytopes), kept across planning cycles so replanning
+    // doesn't allocate them again
+    corridor::CorridorWorkspace _corridor_workspace;
+
+    // threads of the parallel parts of a planning cycle, started once
+    WorkerPool _workers;
+
+    // last goal moved by projectIntoMap, where it went, and the cells
+    // around the goal which have to stay the same to keep it
+    Eigen::Vector2d _projected_goal, _projected_to;
+    int _projected_x0, _projected_xn, _projected_y0, _projected_yn;
+    bool _projection_valid;
+
+    // planners of the parallel failsafe searches, one per start, and the
+    // cells changed since they last caught up with the map snapshot
+    std::vector<JPSPlan> _failsafe_jps;
+    int _failsafe_x0, _failsafe_xn, _failsafe_y0, _failsafe_yn;
+
     Trajectory<5> traj;
 
     const double JACKAL_MAX_VEL = 1.0;
     double _max_vel, _dt, _const_factor, _lookahead, _traj_dt, 
-    _prev_jps_cost, _max_dist_horizon;
+    _max_dist_horizon, _jps_reuse_tolerance, _jps_epsilon, _jps_epsilon_step,
+    _jps_time_budget, _failsafe_start_spacing, _failsafe_deadline;
 
-    int _failsafe_count;
+    int _failsafe_count, _jps_landmarks, _hpa_cluster_size, _horizon_candidates,
+        _jps_los_margin, _jps_max_expansions, _jps_cost_threshold, _failsafe_starts,
+        _corridor_boundary, _corridor_decimation, _corridor_threads, _jps_reuse_cycles;
 
     nav_msgs::OccupancyGrid map;
     
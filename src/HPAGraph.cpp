@@ -0,0 +1,463 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include <robust_fast_navigation/HPAGraph.h>
+
+/**********************************************************************
+  Entrances are made of the maximal runs of border rows (or columns)
+  where the cells on both sides are free: a short run gets one
+  transition in its middle, a long one (6 cells or more) one at each
+  end. Where the two sides only touch diagonally, that diagonal pair is
+  used as a transition. A diagonal squeeze exactly through the corner
+  shared by four clusters is not represented.
+***********************************************************************/
+
+HPAGraph::HPAGraph(){
+    _map = nullptr;
+    sizeX = 0;
+    sizeY = 0;
+    clusterSize = 32;
+    clustersX = 0;
+    clustersY = 0;
+    numExpansions = 0;
+    built = false;
+    bfsX0 = bfsY0 = bfsW = bfsH = 0;
+    memset(blockedLut, 0, sizeof(blockedLut));
+    set_occ_value(100);
+}
+
+/**********************************************************************
+  Set the value of the blocked cells, as for JPSPlan::set_occ_value.
+***********************************************************************/
+void HPAGraph::set_occ_value(double x){
+    uint8_t rule[256];
+    for(int v = 0; v < 256; v++)
+        rule[v] = v == x;
+    set_blocked_rule(rule);
+}
+
+/**********************************************************************
+  Block the cells whose cost is flagged in rule (256 entries), e.g. the
+  rule of the JPSPlan refining the routes (JPSPlan::get_blocked_rule) 
+  so both agree on which cells are free. The graph is rebuilt on the
+  next call to plan if the rule changed.
+***********************************************************************/
+void HPAGraph::set_blocked_rule(const uint8_t* rule){
+    if (memcmp(rule, blockedLut, sizeof(blockedLut)) != 0)
+        built = false;
+    memcpy(blockedLut, rule, sizeof(blockedLut));
+}
+
+/**********************************************************************
+  Set the side length of the clusters in cells. Bigger clusters make
+  for a smaller abstract graph but coarser routes and slower rebuilds
+  of the clusters around changed cells.
+***********************************************************************/
+void HPAGraph::set_cluster_size(int size){
+    if (size != clusterSize)
+        built = false;
+    clusterSize = std::max(size, 2);
+}
+
+/**********************************************************************
+  Set the grid the graph is built on. The graph is (re)built on the
+  next call to plan if the map or its size changed, otherwise changes
+  to its cells have to be reported through update_map.
+***********************************************************************/
+void HPAGraph::set_map(const unsigned char* map, int sizeX, int sizeY){
+    if (map != _map || sizeX != this->sizeX || sizeY != this->sizeY)
+        built = false;
+
+    _map = map;
+    this->sizeX = sizeX;
+    this->sizeY = sizeY;
+}
+
+int HPAGraph::cluster_of(int ind) const{
+    return (ind / sizeX / clusterSize)*clustersX + (ind % sizeX) / clusterSize;
+}
+
+int HPAGraph::local_index(const HPACluster& cl, int cell) const{
+    for(size_t k = 0; k < cl.nodes.size(); k++)
+        if (cl.nodes[k] == cell)
+            return k;
+    return -1;
+}
+
+int HPAGraph::get_num_nodes() const{
+    int n = 0;
+    for(size_t c = 0; c < clusters.size(); c++)
+        n += clusters[c].nodes.size();
+    return n;
+}
+
+/**********************************************************************
+  Build the whole graph from the map.
+***********************************************************************/
+void HPAGraph::build(){
+
+    int cells = sizeX*sizeY;
+    occ.resize(cells);
+    for(int i = 0; i < cells; i++)
+        occ[i] = blockedLut[_map[i]];
+
+    clustersX = (sizeX + clusterSize - 1) / clusterSize;
+    clustersY = (sizeY + clusterSize - 1) / clusterSize;
+    int n = clustersX*clustersY;
+
+    clusters.assign(n, HPACluster());
+    vBorders.assign(n, std::vector<HPATransition>());
+    hBorders.assign(n, std::vector<HPATransition>());
+
+    for(int c = 0; c < n; c++){
+        build_border(c, true);
+        build_border(c, false);
+    }
+
+    for(int c = 0; c < n; c++)
+        build_cluster(c);
+
+    built = true;
+}
+
+/**********************************************************************
+  Find the transitions across the border between cluster c and the
+  cluster to its right (vertical) or above it (horizontal).
+***********************************************************************/
+void HPAGraph::build_border(int c, bool vertical){
+
+    std::vector<HPATransition>& border = vertical ? vBorders[c] : hBorders[c];
+    border.clear();
+
+    int cx = c % clustersX;
+    int cy = c / clustersX;
+    if ((vertical && cx+1 >= clustersX) || (!vertical && cy+1 >= clustersY))
+        return;
+
+    // cells on side a (this cluster) and side b of the border, k-th one
+    // is at a0 + k*step and b0 + k*step
+    int a0, b0, step, len;
+    if (vertical){
+        int x = (cx+1)*clusterSize - 1;
+        int y0 = cy*clusterSize;
+        a0 = y0*sizeX + x;
+        b0 = a0 + 1;
+        step = sizeX;
+        len = std::min(clusterSize, sizeY - y0);
+    } else{
+        int y = (cy+1)*clusterSize - 1;
+        int x0 = cx*clusterSize;
+        a0 = y*sizeX + x0;
+        b0 = a0 + sizeX;
+        step = 1;
+        len = std::min(clusterSize, sizeX - x0);
+    }
+
+    HPATransition t;
+    int k = 0;
+    while (k < len){
+        if (blocked(a0 + k*step) || blocked(b0 + k*step)){
+            // sides only touching diagonally
+            bool next_straight = k+1 < len && !blocked(a0 + (k+1)*step) && !blocked(b0 + (k+1)*step);
+            if (k+1 < len && !next_straight){
+                if (!blocked(a0 + k*step) && !blocked(b0 + (k+1)*step)){
+                    t.a = a0 + k*step;
+                    t.b = b0 + (k+1)*step;
+                    border.push_back(t);
+                } else if (!blocked(a0 + (k+1)*step) && !blocked(b0 + k*step)){
+                    t.a = a0 + (k+1)*step;
+                    t.b = b0 + k*step;
+                    border.push_back(t);
+                }
+            }
+            k++;
+            continue;
+        }
+
+        int s = k;
+        while (k < len && !blocked(a0 + k*step) && !blocked(b0 + k*step))
+            k++;
+        int e = k-1;
+
+        if (e - s + 1 >= 6){
+            t.a = a0 + s*step;
+            t.b = b0 + s*step;
+            border.push_back(t);
+            t.a = a0 + e*step;
+            t.b = b0 + e*step;
+            border.push_back(t);
+        } else{
+            t.a = a0 + (s+e)/2*step;
+            t.b = b0 + (s+e)/2*step;
+            border.push_back(t);
+        }
+    }
+}
+
+void HPAGraph::add_node(HPACluster& cl, int cell, int partner){
+    int k = local_index(cl, cell);
+    if (k < 0){
+        cl.nodes.push_back(cell);
+        cl.partners.push_back(std::vector<int>());
+        k = cl.nodes.size()-1;
+    }
+    cl.partners[k].push_back(partner);
+}
+
+/**********************************************************************
+  Collect the entrance cells of cluster c from its four borders and
+  compute their distances to each other inside the cluster.
+***********************************************************************/
+void HPAGraph::build_cluster(int c){
+
+    HPACluster& cl = clusters[c];
+    cl.nodes.clear();
+    cl.partners.clear();
+
+    int cx = c % clustersX;
+    int cy = c / clustersX;
+
+    for(size_t i = 0; i < vBorders[c].size(); i++)
+        add_node(cl, vBorders[c][i].a, vBorders[c][i].b);
+    for(size_t i = 0; i < hBorders[c].size(); i++)
+        add_node(cl, hBorders[c][i].a, hBorders[c][i].b);
+    if (cx > 0)
+        for(size_t i = 0; i < vBorders[c-1].size(); i++)
+            add_node(cl, vBorders[c-1][i].b, vBorders[c-1][i].a);
+    if (cy > 0)
+        for(size_t i = 0; i < hBorders[c-clustersX].size(); i++)
+            add_node(cl, hBorders[c-clustersX][i].b, hBorders[c-clustersX][i].a);
+
+    int n = cl.nodes.size();
+    cl.dist.assign(n*n, -1);
+    for(int i = 0; i < n; i++){
+        cluster_bfs(c, cl.nodes[i]);
+        for(int j = 0; j < n; j++)
+            cl.dist[i*n + j] = cluster_dist(cl.nodes[j]);
+    }
+}
+
+/**********************************************************************
+  Breadth first search from source restricted to the cells of cluster
+  c. The result is read with cluster_dist, for the cluster of the last
+  search.
+***********************************************************************/
+void HPAGraph::cluster_bfs(int c, int source){
+
+    bfsX0 = (c % clustersX)*clusterSize;
+    bfsY0 = (c / clustersX)*clusterSize;
+    bfsW = std::min(clusterSize, sizeX - bfsX0);
+    bfsH = std::min(clusterSize, sizeY - bfsY0);
+
+    bfsDist.assign(bfsW*bfsH, -1);
+    bfsQueue.clear();
+
+    int sx = source % sizeX - bfsX0;
+    int sy = source / sizeX - bfsY0;
+    bfsDist[sy*bfsW + sx] = 0;
+    bfsQueue.push_back(sy*bfsW + sx);
+
+    for(size_t head = 0; head < bfsQueue.size(); head++){
+        int l = bfsQueue[head];
+        int x = l % bfsW;
+        int y = l / bfsW;
+        int d = bfsDist[l] + 1;
+
+        for(int ny = std::max(y-1, 0); ny <= std::min(y+1, bfsH-1); ny++)
+            for(int nx = std::max(x-1, 0); nx <= std::min(x+1, bfsW-1); nx++){
+                int nl = ny*bfsW + nx;
+                if (bfsDist[nl] < 0 && !blocked((bfsY0+ny)*sizeX + bfsX0+nx)){
+                    bfsDist[nl] = d;
+                    bfsQueue.push_back(nl);
+                }
+            }
+    }
+}
+
+int HPAGraph::cluster_dist(int cell) const{
+    int x = cell % sizeX - bfsX0;
+    int y = cell / sizeX - bfsY0;
+    return bfsDist[y*bfsW + x];
+}
+
+/**********************************************************************
+  Report that cells inside [x0,xn) x [y0,yn) may have changed. Cells
+  are compared against the snapshot the graph was built on, and only
+  the borders of the clusters holding changed cells, and the clusters
+  around those borders, are rebuilt.
+***********************************************************************/
+void HPAGraph::update_map(int x0, int xn, int y0, int yn){
+
+    if (!built)
+        return;
+
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    xn = std::min(xn, sizeX);
+    yn = std::min(yn, sizeY);
+
+    std::vector<int> dirty;
+    for(int y = y0; y < yn; y++)
+        for(int x = x0; x < xn; x++){
+            int ind = y*sizeX + x;
+            uint8_t o = blockedLut[_map[ind]];
+            if (o != occ[ind]){
+                occ[ind] = o;
+                dirty.push_back(cluster_of(ind));
+            }
+        }
+
+    if (dirty.empty())
+        return;
+
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    // borders of a dirty cluster, and every cluster sharing one of them
+    std::vector<int> rebuild;
+    for(size_t i = 0; i < dirty.size(); i++){
+        int c = dirty[i];
+        int cx = c % clustersX;
+        int cy = c / clustersX;
+
+        build_border(c, true);
+        build_border(c, false);
+        if (cx > 0)
+            build_border(c-1, true);
+        if (cy > 0)
+            build_border(c-clustersX, false);
+
+        rebuild.push_back(c);
+        if (cx > 0)
+            rebuild.push_back(c-1);
+        if (cx+1 < clustersX)
+            rebuild.push_back(c+1);
+        if (cy > 0)
+            rebuild.push_back(c-clustersX);
+        if (cy+1 < clustersY)
+            rebuild.push_back(c+clustersX);
+    }
+
+    std::sort(rebuild.begin(), rebuild.end());
+    rebuild.erase(std::unique(rebuild.begin(), rebuild.end()), rebuild.end());
+    for(size_t i = 0; i < rebuild.size(); i++)
+        build_cluster(rebuild[i]);
+}
+
+/**********************************************************************
+  A* over the abstract graph, with the start and goal linked to the
+  entrance cells of their clusters.
+
+  Inputs:
+    - start, goal: flat indices of the start and goal cells
+
+  Returns:
+    - True if a route was found, route then holds the start, the
+      entrance cells along the way and the goal
+***********************************************************************/
+bool HPAGraph::plan(int start, int goal, std::vector<int>& route){
+
+    route.clear();
+    numExpansions = 0;
+
+    if (!built)
+        build();
+
+    if (blocked(start) || blocked(goal))
+        return false;
+
+    int cs = cluster_of(start);
+    int cg = cluster_of(goal);
+    const HPACluster& cls = clusters[cs];
+    const HPACluster& clg = clusters[cg];
+
+    cluster_bfs(cs, start);
+    std::vector<int> startDist(cls.nodes.size());
+    for(size_t k = 0; k < cls.nodes.size(); k++)
+        startDist[k] = cluster_dist(cls.nodes[k]);
+    int direct = cs == cg ? cluster_dist(goal) : -1;
+
+    cluster_bfs(cg, goal);
+    std::vector<int> goalDist(clg.nodes.size());
+    for(size_t k = 0; k < clg.nodes.size(); k++)
+        goalDist[k] = cluster_dist(clg.nodes[k]);
+
+    // the start and goal are separate vertices (even if their cells are
+    // entrance cells), with ids -1 and -2
+    const int START = -1, GOAL = -2;
+    int gx = goal % sizeX, gy = goal / sizeX;
+
+    std::unordered_map<int, int> g, parent;
+    std::vector<std::pair<int, int> > open;
+    std::greater<std::pair<int, int> > cmp;
+
+    g[START] = 0;
+    parent[START] = START;
+    open.push_back(std::make_pair(0, START));
+
+    while (!open.empty()){
+        std::pop_heap(open.begin(), open.end(), cmp);
+        int u = open.back().second;
+        int f = open.back().first;
+        open.pop_back();
+
+        int gu = g[u];
+        int cell = u == START ? start : u;
+        int h = u == GOAL ? 0 : std::max(abs(cell % sizeX - gx), abs(cell / sizeX - gy));
+        if (f > gu + h)
+            continue;
+
+        if (u == GOAL){
+            for(int v = GOAL; v != START; v = parent[v])
+                route.push_back(v == GOAL ? goal : v);
+            route.push_back(start);
+            std::reverse(route.begin(), route.end());
+            route.erase(std::unique(route.begin(), route.end()), route.end());
+            return true;
+        }
+
+        numExpansions++;
+
+        // edges out of u, as (vertex, cost)
+        std::vector<std::pair<int, int> > edges;
+        if (u == START){
+            for(size_t k = 0; k < cls.nodes.size(); k++)
+                if (startDist[k] >= 0)
+                    edges.push_back(std::make_pair(cls.nodes[k], startDist[k]));
+            if (direct >= 0)
+                edges.push_back(std::make_pair(GOAL, direct));
+        } else{
+            int c = cluster_of(u);
+            const HPACluster& cl = clusters[c];
+            int n = cl.nodes.size();
+            int li = local_index(cl, u);
+            for(int m = 0; m < n; m++)
+                if (m != li && cl.dist[li*n + m] >= 0)
+                    edges.push_back(std::make_pair(cl.nodes[m], cl.dist[li*n + m]));
+            for(size_t p = 0; p < cl.partners[li].size(); p++)
+                edges.push_back(std::make_pair(cl.partners[li][p], 1));
+            if (c == cg && goalDist[li] >= 0)
+                edges.push_back(std::make_pair(GOAL, goalDist[li]));
+        }
+
+        for(size_t e = 0; e < edges.size(); e++){
+            int v = edges[e].first;
+            int gv = gu + edges[e].second;
+            std::unordered_map<int, int>::iterator it = g.find(v);
+            if (it != g.end() && it->second <= gv)
+                continue;
+
+            g[v] = gv;
+            parent[v] = u;
+            int hv = v == GOAL ? 0 : std::max(abs(v % sizeX - gx), abs(v / sizeX - gy));
+            open.push_back(std::make_pair(gv + hv, v));
+            std::push_heap(open.begin(), open.end(), cmp);
+        }
+    }
+
+    return false;
+}
@@ -1,6 +1,9 @@
 #include <math.h>
+#include <chrono>
+#include <limits>
 #include <string>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
@@ -16,6 +19,76 @@ JPSPlan::JPSPlan(){
     originX = 0;
     originY = 0;
     resolution = 1;
+    sizeX = 0;
+    sizeY = 0;
+    generation = 0;
+    _map = nullptr;
+    scanMode = SCAN_CELLS;
+    tablesValid = false;
+    rowWords = 0;
+    colWords = 0;
+    searchMode = SEARCH_FORWARD;
+    queueMode = QUEUE_HEAP;
+    numPushes = 0;
+    numExpansions = 0;
+    numScanned = 0;
+    numClosedHits = 0;
+    searchTime = 0;
+    bucketMin = 0;
+    bucketMax = -1;
+    bucketCount = 0;
+    biActive = false;
+    otherBucketMin = 0;
+    otherBucketMax = -1;
+    otherBucketCount = 0;
+    incValid = false;
+    incStart = -1;
+    incGoal = -1;
+    km = 0;
+    losMode = LOS_BRESENHAM;
+    losMargin = 0;
+    losValid = false;
+    cacheDest = -1;
+    cacheReuses = 0;
+    epsStart = 1;
+    epsStep = 0;
+    maxTime = 0;
+    maxExpansions = 0;
+    weight = 1;
+    partialPath = false;
+    pathEps = 1;
+    closestInd = -1;
+    closestH = 0;
+    costThreshold = 0;
+    unknownBlocked = true;
+    memset(blockedLut, 0, sizeof(blockedLut));
+    set_blocked_rule();
+}
+
+/**********************************************************************
+  Select the line of sight test used by simplifyPath and the any-angle
+  search. LOS_BRESENHAM walks the cells along the line on every query,
+  LOS_DISTANCE jumps along it using a distance field of the blocked 
+  cells (see JPSLineOfSight.cpp), which is built once and then patched
+  by update_map. It checks every cell a segment touches, so it is 
+  stricter than Bresenham, and can keep a margin around obstacles.
+
+  Inputs:
+    - mode: line of sight test to use
+***********************************************************************/
+void JPSPlan::set_los_mode(JPSLosMode mode){
+    losMode = mode;
+}
+
+/**********************************************************************
+  Set the clearance, in cells, segments must keep from blocked cells to
+  be in line of sight. Only used in the LOS_DISTANCE mode.
+
+  Inputs:
+    - cells: clearance margin (Chebyshev distance) in cells
+***********************************************************************/
+void JPSPlan::set_los_margin(int cells){
+    losMargin = std::max(cells, 0);
 }
 
 /**********************************************************************
@@ -76,6 +149,20 @@ double JPSPlan::euclidean_dist(int x, int y){
     return sqrt((x-destX)*(x-destX) + (y-destY)*(y-destY));
 }
 
+/**********************************************************************
+  Cost-to-go estimate used to order the open list. With landmarks (see
+  set_landmarks) it is raised to their lower bound where that is larger,
+  which happens around walls, and becomes infinite for cells which are
+  not connected to the destination at all. The anytime search scales it
+  by its current weight.
+***********************************************************************/
+double JPSPlan::heuristic(int x, int y){
+    double h = manhattan_distance(x,y); // octile_dist(x,y);
+    if (landmarks)
+        h = std::max(h, landmarks->lower_bound(y*sizeX + x, destY*sizeX + destX));
+    return weight*h;
+}
+
 /**********************************************************************
   Set the value which the JPS should use as occupied in the grid. For
   traditional maps/costmaps this value is usually 100 or 253/254 (in 
@@ -86,6 +173,166 @@ double JPSPlan::euclidean_dist(int x, int y){
 ***********************************************************************/
 void JPSPlan::set_occ_value(double x){
     occupied_val = x;
+    set_blocked_rule();
+}
+
+/**********************************************************************
+  Block every cell whose cost is at least threshold instead of only the
+  cells equal to the occupied value, e.g. lethal as well as inscribed
+  cells of a costmap. Unknown cells (255, NO_INFORMATION in ROS) are 
+  blocked only if unknown_blocked is set. A threshold <= 0 goes back
+  to blocking the occupied value only.
+
+  Inputs:
+    - threshold: lowest cost of a blocked cell, <= 0 to disable
+    - unknown_blocked: whether unknown cells are blocked
+***********************************************************************/
+void JPSPlan::set_cost_threshold(int threshold, bool unknown_blocked){
+    costThreshold = threshold;
+    unknownBlocked = unknown_blocked;
+    set_blocked_rule();
+}
+
+/**********************************************************************
+  Work out which cost values are blocked under the current settings.
+  If that changed, everything built from the blocked cells is dropped,
+  landmarks included, and the blocked mask is built again.
+***********************************************************************/
+void JPSPlan::set_blocked_rule(){
+
+    uint8_t lut[256];
+    for(int v = 0; v < 256; v++)
+        lut[v] = costThreshold > 0 ? v >= costThreshold : v == occupied_val;
+    if (costThreshold > 0)
+        lut[255] = unknownBlocked;
+
+    if (memcmp(lut, blockedLut, sizeof(lut)) == 0)
+        return;
+
+    memcpy(blockedLut, lut, sizeof(lut));
+    tablesValid = false;
+    incValid = false;
+    losValid = false;
+    clearPathCache();
+    landmarks.reset();
+
+    if (_map)
+        build_blocked_mask();
+}
+
+
+/**********************************************************************
+  Select how jumps are performed during the search. SCAN_CELLS walks
+  the grid cell by cell, SCAN_JPS_PLUS looks the jumps up in tables 
+  which are precomputed for the whole map (see JPSPlus.cpp) and 
+  SCAN_BLOCK does the straight scans on a bit-packed copy of the map,
+  64 cells at a time (see JPSBlock.cpp). The precomputed data is built
+  lazily on the next call to JPS().
+
+  Inputs:
+    - mode: scan mode to use for subsequent searches
+***********************************************************************/
+void JPSPlan::set_scan_mode(JPSScanMode mode){
+    if (mode != scanMode)
+        tablesValid = false;
+    scanMode = mode;
+}
+
+/**********************************************************************
+  Select the open list used during the search. QUEUE_HEAP is a binary
+  heap ordered on the exact f-cost. QUEUE_BUCKET keeps one bucket per
+  integer f-cost, which is exact here since both the cost-to-come and
+  the manhattan heuristic are integral on the grid, and makes push and
+  pop O(1) amortized. Nodes with equal f-cost may come out in a 
+  different order, so paths of equal length can differ between modes.
+
+  Inputs:
+    - mode: queue mode to use for subsequent searches
+***********************************************************************/
+void JPSPlan::set_queue_mode(JPSQueueMode mode){
+    clear_queue();
+    queueMode = mode;
+}
+
+/**********************************************************************
+  Select the search algorithm. SEARCH_FORWARD runs a jump point search
+  from scratch on every call to JPS(). SEARCH_INCREMENTAL runs D* Lite
+  (see JPSIncremental.cpp), which keeps its search tree between calls
+  and only repairs the part affected by the start moving and by the
+  cells reported through update_map. The goal changing, or the map 
+  being replaced, restarts it from scratch. SEARCH_BIDIRECTIONAL runs 
+  the jump point search from the start and from the destination at the
+  same time until they meet (see JPSBidirectional.cpp). SEARCH_THETA
+  runs an any-angle Lazy Theta* (see JPSTheta.cpp) whose paths are 
+  nearly taut already, getPath still simplifies them to merge the
+  close vertices left around rounded obstacles.
+
+  Inputs:
+    - mode: search mode to use for subsequent searches
+***********************************************************************/
+void JPSPlan::set_search_mode(JPSSearchMode mode){
+    if (mode != searchMode)
+        incValid = false;
+    searchMode = mode;
+}
+
+/**********************************************************************
+  Use precomputed landmark distance fields (see JPSLandmarks.h) for
+  the heuristic of the jump point searches, and to prune nodes which 
+  can't reach the destination. The fields must have been computed on
+  the map given to set_map, with the same blocked rule (see 
+  get_blocked_rule), otherwise they are ignored. Pass an empty pointer
+  to stop using them.
+
+  Inputs:
+    - lm: landmark fields, shared so they can be built in the
+      background and handed over once ready
+***********************************************************************/
+void JPSPlan::set_landmarks(const std::shared_ptr<const JPSLandmarks>& lm){
+    if (lm && (lm->size_x() != sizeX || lm->size_y() != sizeY || lm->num_landmarks() == 0 ||
+               !lm->same_rule(blockedLut))){
+        std::cerr << "landmarks don't match the map, ignoring them" << std::endl;
+        landmarks.reset();
+        return;
+    }
+    landmarks = lm;
+
+    if (_map)
+        drop_stale_landmarks(0, sizeX, 0, sizeY);
+}
+
+/**********************************************************************
+  Weights for the anytime search (see JPSAnytime.cpp) of SEARCH_FORWARD.
+  The first search runs with the heuristic scaled by eps_start, which
+  expands far fewer nodes for a path at most that many times longer.
+  While the budget (see set_budget) allows it, the search is repeated
+  with the weight lowered by eps_step each time, down to 1, and the
+  shortest path found is kept.
+
+  Inputs:
+    - eps_start: weight of the first search, 1 for a plain search
+    - eps_step: how much the weight is lowered between searches, 0 to
+      stop after the first path
+***********************************************************************/
+void JPSPlan::set_epsilon_schedule(double eps_start, double eps_step){
+    epsStart = std::max(eps_start, 1.);
+    epsStep = std::max(eps_step, 0.);
+}
+
+/**********************************************************************
+  Bound the work done by JPS() in SEARCH_FORWARD mode. When the budget
+  runs out before any path has been found, getPath returns a partial
+  path to the expanded cell with the lowest heuristic instead, and
+  is_partial() is set. The same happens when the destination turns out
+  to be unreachable. Other search modes ignore the budget.
+
+  Inputs:
+    - max_time: wall clock budget in seconds, 0 for none
+    - max_expansions: budget in expanded nodes, 0 for none
+***********************************************************************/
+void JPSPlan::set_budget(double max_time, int max_expansions){
+    maxTime = std::max(max_time, 0.);
+    maxExpansions = std::max(max_expansions, 0);
 }
 
 /**********************************************************************
@@ -104,11 +351,11 @@ void JPSPlan::set_occ_value(double x){
     - cost: heuristic cost-to-go associated with the node.
 ***********************************************************************/
 void JPSPlan::add_to_queue(int x, int y, int dirx, int diry, double cost){
-    
-    static int count = 0;
 
-    if (closedSet.find(y*sizeX + x) != closedSet.end())
+    if (is_closed(y*sizeX + x)){
+        numClosedHits++;
         return;
+    }
     
     //std::cout << "adding to queue (" << x << ", " << y << ", " << dirx << ", " << diry << ")" << std::endl;
 
@@ -118,9 +365,14 @@ void JPSPlan::add_to_queue(int x, int y, int dirx, int diry, double cost){
     node.dirx = dirx;
     node.diry = diry;
     node.cost = cost;
-    node.manhattan = manhattan_distance(x,y); // octile_dist(x,y);
-    q.push(node);
-    count += 1;
+    node.manhattan = heuristic(x,y);
+
+    // the destination can't be reached from here
+    if (node.manhattan == std::numeric_limits<double>::infinity())
+        return;
+
+    push_node(node);
+    numPushes += 1;
 }
 
 /**********************************************************************
@@ -144,7 +396,7 @@ bool JPSPlan::explore_straight(const JPSNode_t& start){
     double cost = start.cost;
     JPSNode_t curr = start;
 
-    closedSet[start.y*sizeX + start.x] = true;
+    set_closed(start.y*sizeX + start.x);
     //std::cout << "explore straight (" << start.x << ", " << start.y << ", " << dirx << ", " << diry << ")" << std::endl;
 
     while (true){
@@ -152,6 +404,7 @@ bool JPSPlan::explore_straight(const JPSNode_t& start){
         n.x += dirx;
         n.y += diry;
         cost += 1;
+        numScanned++;
         // if(start.x == 21 && start.y == 26)
         //     //std::cout << "[straight](" << curr.x << ", " << curr.y << ")" << std::endl;
         // is node on border?
@@ -163,13 +416,13 @@ bool JPSPlan::explore_straight(const JPSNode_t& start){
             return false;
         }
 
-        if(_map[n.y*sizeX + n.x] == occupied_val){
+        if(blocked(n.y*sizeX + n.x)){
             return false;
         }
 
-        if ( n.x == destX && n.y == destY){
+        if (is_target(n.y*sizeX + n.x)){
             //std::cout << "GOAL FOUND" << std::endl;
-            parents[n.y*sizeX + n.x] = start.y*sizeX + start.x;
+            set_parent(n.y*sizeX + n.x, start.y*sizeX + start.x, cost);
             add_to_queue(n.x, n.y, n.dirx, n.diry, cost);
             return true;
         }
@@ -177,13 +430,13 @@ bool JPSPlan::explore_straight(const JPSNode_t& start){
         // only one of dirx or diry can be non-zero in this function call
         bool added = false;
         if (dirx != 0){
-            if (n.y != sizeY-1 &&_map[(n.y+1)*sizeX + n.x] == occupied_val && _map[(n.y+1)*sizeX + n.x+dirx] != occupied_val){
+            if (blocked_xy(n.x, n.y+1) && !blocked_xy(n.x+dirx, n.y+1)){
                 //std::cout << "found forced at (" << n.x << "," << n.y << ")\t" << dirx << "\t1" << std::endl;
                 add_to_queue(n.x, n.y, dirx, 1, cost);
                 added = true;
             }
 
-            if (n.y != 0 && _map[(n.y-1)*sizeX + n.x] == occupied_val && _map[(n.y-1)*sizeX + n.x+dirx] != occupied_val){
+            if (blocked_xy(n.x, n.y-1) && !blocked_xy(n.x+dirx, n.y-1)){
                 //std::cout << "found forced at (" << n.x << "," << n.y << ")\t" << dirx << "\t-1" << std::endl;
                 add_to_queue(n.x, n.y, dirx, -1, cost);
                 added = true;
@@ -191,13 +444,13 @@ bool JPSPlan::explore_straight(const JPSNode_t& start){
         }
         
         else{
-            if (n.x != sizeX-1 && _map[n.y*sizeX + n.x+1] == occupied_val && _map[(n.y+diry)*sizeX + n.x+1] != occupied_val){
+            if (blocked_xy(n.x+1, n.y) && !blocked_xy(n.x+1, n.y+diry)){
                 //std::cout << "found forced at (" << n.x << "," << n.y << ")\t1\t" << diry << std::endl;
                 add_to_queue(n.x, n.y, 1, diry, cost);
                 added = true;
             }
 
-            if (n.x != 0 && _map[n.y*sizeX + n.x-1] == occupied_val && _map[(n.y+diry)*sizeX + n.x-1] != occupied_val){
+            if (blocked_xy(n.x-1, n.y) && !blocked_xy(n.x-1, n.y+diry)){
                 //std::cout << "found forced at (" << n.x << "," << n.y << ")\t-1\t" << diry << std::endl;
                 add_to_queue(n.x, n.y, -1, diry, cost);
                 added = true;
@@ -207,7 +460,7 @@ bool JPSPlan::explore_straight(const JPSNode_t& start){
 
         // if node has any forced neighbords, it is a jump point, so add to queue as well
         if (added){
-            parents[n.y*sizeX + n.x] = start.y*sizeX + start.x;
+            set_parent(n.y*sizeX + n.x, start.y*sizeX + start.x, cost);
             //std::cout << "parent of (" <<n.x<< "," <<n.y<< ") is (" <<start.x<< "," <<start.y<< ")" << std::endl;
             add_to_queue(n.x, n.y, n.dirx, n.diry, cost);
             return true;
@@ -244,7 +497,7 @@ bool JPSPlan::explore_diagonal(const JPSNode_t& start){
 
     double cost = start.cost;
     JPSNode_t curr = start;
-    closedSet[start.y*sizeX + start.x] = true;
+    set_closed(start.y*sizeX + start.x);
 
     //std::cout << "explore diagonal (" << start.x << ", " << start.y << ", " << dirx << ", " << diry << ")" << std::endl;
     
@@ -253,6 +506,7 @@ bool JPSPlan::explore_diagonal(const JPSNode_t& start){
         n.x += dirx;
         n.y += diry;
         cost += 1; //sqrt(2);
+        numScanned++;
 
         // //std::cout << "[diagonal] curr is: " << "(" << curr.x << ", " << curr.y << ")" << std::endl;
 
@@ -261,28 +515,28 @@ bool JPSPlan::explore_diagonal(const JPSNode_t& start){
             return false;
         }
 
-        if(_map[n.y*sizeX + n.x] == occupied_val){
+        if(blocked(n.y*sizeX + n.x)){
             return false;
         }
 
-        if ( n.x == destX && n.y == destY){
+        if (is_target(n.y*sizeX + n.x)){
             //std::cout << "GOAL FOUND" << std::endl;
-            parents[n.y*sizeX + n.x] = start.y*sizeX + start.x;
+            set_parent(n.y*sizeX + n.x, start.y*sizeX + start.x, cost);
             add_to_queue(n.x, n.y, n.dirx, n.diry, cost);
             return true;
         }
 
         bool added = false;
-        if ( _map[n.y*sizeX + curr.x] == occupied_val && _map[(n.y+diry)*sizeX + curr.x] != occupied_val){
+        if (blocked_xy(curr.x, n.y) && !blocked_xy(curr.x, n.y+diry)){
             //std::cout << "JP @ (" << n.x << "," << n.y << ")" << std::endl;
-            parents[n.y*sizeX + n.x] = start.y*sizeX + start.x;
+            set_parent(n.y*sizeX + n.x, start.y*sizeX + start.x, cost);
             add_to_queue(n.x, n.y, -n.dirx, n.diry, cost);
             added = true;
         }
 
-        if ( _map[curr.y*sizeX + n.x] == occupied_val && _map[curr.y*sizeX + n.x+dirx] != occupied_val){
+        if (blocked_xy(n.x, curr.y) && !blocked_xy(n.x+dirx, curr.y)){
             //std::cout << "JP @ (" << n.x << "," << n.y << ")" << std::endl;
-            parents[n.y*sizeX + n.x] = start.y*sizeX + start.x;
+            set_parent(n.y*sizeX + n.x, start.y*sizeX + start.x, cost);
             add_to_queue(n.x, n.y, n.dirx, -n.diry, cost);
             added = true;
         }
@@ -293,7 +547,8 @@ bool JPSPlan::explore_diagonal(const JPSNode_t& start){
         horN.dirx = dirx;
         horN.diry = 0;
         horN.cost = cost;
-        bool found_hor = explore_straight(horN);
+        bool found_hor = scanMode == SCAN_BLOCK ? explore_straight_block(horN)
+                                                : explore_straight(horN);
         
         JPSNode_t verN;
         verN.x = n.x;
@@ -301,10 +556,11 @@ bool JPSPlan::explore_diagonal(const JPSNode_t& start){
         verN.dirx = 0;
         verN.diry = diry;
         verN.cost = cost;
-        bool found_ver = explore_straight(verN);
+        bool found_ver = scanMode == SCAN_BLOCK ? explore_straight_block(verN)
+                                                : explore_straight(verN);
 
         if (found_ver || found_hor){
-            parents[n.y*sizeX + n.x] = start.y*sizeX + start.x;
+            set_parent(n.y*sizeX + n.x, start.y*sizeX + start.x, cost);
             // add_to_queue(n.x, n.y, n.dirx, n.diry, cost);
             // return true;
         }
@@ -330,23 +586,166 @@ bool JPSPlan::explore_diagonal(const JPSNode_t& start){
 }
 
 /**********************************************************************
-  This function starts off the actual JPS and terminates when the goal
-  has been found or all grid cells have been examined. To start the
-  JPS, add the start coordinate to the queue in all possible directions.
+  This function records the parent of a grid cell for path extraction.
+  Only the first parent is kept, which guarantees the parents array 
+  forms a tree rooted at the start and getPath can't walk into a cycle.
+  For searches that reach every cell in cost order (breadth first, 
+  D* Lite chains) that is also the cheapest one.
+
+  Inputs:
+    - ind: flat index of the grid cell
+    - parent: flat index of the cell it was reached from
 ***********************************************************************/
-void JPSPlan::JPS(){
+void JPSPlan::set_parent(int ind, int parent){
+    if (parentGen[ind] != generation){
+        parentGen[ind] = generation;
+        parents[ind] = parent;
+    }
+}
+
+/**********************************************************************
+  Same for the jump point searches, which generate a jump point at the
+  cost of its parent plus the jump length and may reach it again more
+  cheaply from another parent later. The parent with the lowest cost g
+  is kept, so the path getPath walks costs what the search popped. A
+  cell's g only ever drops and stays above its parent's, so the parents
+  still form a tree.
 
-    closedSet.clear();
-    parents.clear();
+  Inputs:
+    - ind: flat index of the grid cell
+    - parent: flat index of the cell it was reached from
+    - g: cost of the cell when reached from parent
+***********************************************************************/
+void JPSPlan::set_parent(int ind, int parent, double g){
+    if (parentGen[ind] != generation || g < parentCost[ind]){
+        parentGen[ind] = generation;
+        parents[ind] = parent;
+        parentCost[ind] = g;
+    }
+}
 
-    goalInd = -1;
+/**********************************************************************
+  Push and pop for the open list, either a binary heap stored in a
+  std::vector or an array of buckets (see set_queue_mode). Unlike 
+  std::priority_queue, the vectors can be cleared without giving back
+  their memory, so a long-lived JPSPlan doesn't allocate anything for
+  the queue once it has warmed up.
+***********************************************************************/
+void JPSPlan::push_node(const JPSNode_t& node){
 
-    if ( _map[startY*sizeX + startX] == occupied_val || _map[destY*sizeX + destX] == occupied_val){
-        std::cerr << "start or destination is in occupied space" << std::endl;
+    if (queueMode == QUEUE_HEAP){
+        q.push_back(node);
+        std::push_heap(q.begin(), q.end(), Compare());
         return;
     }
 
-    std::cout << "start " << (int) _map[startY*sizeX + startX] << " and destination " << (int)_map[destY*sizeX + destX] << std::endl;
+    int k = std::max(0, (int) floor(node.cost + node.manhattan));
+    if (k >= (int) buckets.size())
+        buckets.resize(std::max(k+1, 2*(int) buckets.size()));
+
+    JPSBucketNode bnode;
+    bnode.ind = node.y*sizeX + node.x;
+    bnode.dirx = node.dirx;
+    bnode.diry = node.diry;
+    bnode.cost = node.cost;
+    buckets[k].push_back(bnode);
+
+    if (bucketCount == 0 || k < bucketMin)
+        bucketMin = k;
+    bucketMax = std::max(bucketMax, k);
+    bucketCount++;
+}
+
+JPSNode_t JPSPlan::pop_node(){
+
+    JPSNode_t node;
+
+    if (queueMode == QUEUE_HEAP){
+        std::pop_heap(q.begin(), q.end(), Compare());
+        node = q.back();
+        q.pop_back();
+        return node;
+    }
+
+    while (buckets[bucketMin].empty())
+        bucketMin++;
+
+    // last in, first out within a bucket: among nodes of equal f-cost 
+    // the most recently found ones tend to be the closest to the goal
+    const JPSBucketNode& bnode = buckets[bucketMin].back();
+    node.x = bnode.ind % sizeX;
+    node.y = bnode.ind / sizeX;
+    node.dirx = bnode.dirx;
+    node.diry = bnode.diry;
+    node.cost = bnode.cost;
+    node.manhattan = heuristic(node.x, node.y);
+    buckets[bucketMin].pop_back();
+    bucketCount--;
+    return node;
+}
+
+bool JPSPlan::queue_empty() const{
+    return queueMode == QUEUE_HEAP ? q.empty() : bucketCount == 0;
+}
+
+void JPSPlan::clear_queue(){
+    q.clear();
+    for(int k = 0; k <= bucketMax; k++)
+        buckets[k].clear();
+    bucketMin = 0;
+    bucketMax = -1;
+    bucketCount = 0;
+}
+
+/**********************************************************************
+  This function (re)allocates the per-cell search buffers. It is only
+  called when the map dimensions change, otherwise the buffers are 
+  invalidated between searches by bumping the generation counter.
+
+  Inputs:
+    - cells: number of cells in the grid (sizeX*sizeY)
+***********************************************************************/
+void JPSPlan::resize_buffers(int cells){
+    closedSet.assign(cells, 0);
+    parentGen.assign(cells, 0);
+    parents.assign(cells, -1);
+    parentCost.assign(cells, 0);
+    generation = 0;
+
+    // reallocated by the next bidirectional search
+    otherClosed.clear();
+    otherParentGen.clear();
+    otherParents.clear();
+    otherParentCost.clear();
+}
+
+/**********************************************************************
+  Reset the search state before a new search: invalidate all closed /
+  parent entries from the previous search, only wiping the buffers 
+  when the 32 bit counter wraps around, and empty the queue.
+***********************************************************************/
+void JPSPlan::begin_search(){
+    if (++generation == 0){
+        resize_buffers(sizeX*sizeY);
+        generation = 1;
+    }
+    clear_queue();
+
+    goalInd = -1;
+    numPushes = 0;
+    numExpansions = 0;
+    numScanned = 0;
+    numClosedHits = 0;
+    partialPath = false;
+    pathEps = 1;
+    closestInd = -1;
+}
+
+/**********************************************************************
+  Add the start to the queue in all 8 directions and make it the root
+  of the parents tree.
+***********************************************************************/
+void JPSPlan::seed_search(){
 
     // cardinal
     add_to_queue(startX, startY, 1, 0, 0);
@@ -360,30 +759,154 @@ void JPSPlan::JPS(){
     add_to_queue(startX, startY, -1, 1, 0);
     add_to_queue(startX, startY, -1, -1, 0);
 
-    parents[startY*sizeY + startX] = startY*sizeY + startX;
+    set_parent(startY*sizeX + startX, startY*sizeX + startX, 0);
+}
 
-    while (q.size() > 0){
-        JPSNode_t node = q.top();
-        q.pop();
+/**********************************************************************
+  Pop the best node off the queue and jump from it with the scan mode
+  in use.
 
-        //std::cout << "LOOKING AT NODE (" << node.x << ", " << node.y <<  
-        //     ", " << node.dirx << ", " << node.diry << ", " << node.cost+node.manhattan << ")" << std::endl;
+  Returns:
+    - flat index of the node if it is the destination (or a cell 
+      reached by the other direction of a bidirectional search), in
+      which case it isn't explored
+    - -1 otherwise
+***********************************************************************/
+int JPSPlan::expand_next(){
+    JPSNode_t node = pop_node();
+    numExpansions++;
 
-        if (node.x == destX && node.y == destY){
-            goalInd = destY * sizeX + destX;
-            // std::cout << "found goal (" << destX << ", " << destY <<  ") :)" << std::endl;
-            break;
-        }
+    //std::cout << "LOOKING AT NODE (" << node.x << ", " << node.y <<  
+    //     ", " << node.dirx << ", " << node.diry << ", " << node.cost+node.manhattan << ")" << std::endl;
+
+    int ind = node.y*sizeX + node.x;
 
-        if (node.dirx == 0 || node.diry == 0){
+#ifdef JPS_TRACE
+    traceCells.push_back(ind);
+#endif
+
+    // where a partial path would lead if the search is cut short
+    if (closestInd < 0 || node.manhattan < closestH){
+        closestInd = ind;
+        closestH = node.manhattan;
+    }
+    if (is_target(ind)){
+        // std::cout << "found goal (" << destX << ", " << destY <<  ") :)" << std::endl;
+        return ind;
+    }
+
+    if (scanMode == SCAN_JPS_PLUS){
+        if (node.dirx == 0 || node.diry == 0)
+            explore_straight_plus(node);
+        else
+            explore_diagonal_plus(node);
+    }
+    else if (node.dirx == 0 || node.diry == 0){
+        if (scanMode == SCAN_BLOCK)
+            explore_straight_block(node);
+        else
             explore_straight(node);
+    }
+    else{
+        explore_diagonal(node);
+    }
+
+    return -1;
+}
+
+/**********************************************************************
+  Search for a path from the start to the destination with the current
+  search mode, and time it for get_stats.
+***********************************************************************/
+void JPSPlan::JPS(){
+
+#ifdef JPS_TRACE
+    traceCells.clear();
+#endif
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    run_search();
+    searchTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/**********************************************************************
+  This function starts off the actual JPS and terminates when the goal
+  has been found or all grid cells have been examined. To start the
+  JPS, add the start coordinate to the queue in all possible directions.
+***********************************************************************/
+void JPSPlan::run_search(){
+
+    begin_search();
+
+    if ( blocked(startY*sizeX + startX) || blocked(destY*sizeX + destX)){
+        std::cerr << "start or destination is in occupied space" << std::endl;
+        return;
+    }
+
+    std::cout << "start " << (int) _map[startY*sizeX + startX] << " and destination " << (int)_map[destY*sizeX + destX] << std::endl;
+
+    if (searchMode == SEARCH_INCREMENTAL){
+        incremental_search();
+        return;
+    }
+
+    if (searchMode == SEARCH_THETA){
+        theta_search();
+        return;
+    }
+
+    if (scanMode == SCAN_JPS_PLUS && !tablesValid)
+        build_jump_tables();
+    else if (scanMode == SCAN_BLOCK && !tablesValid)
+        build_block_bits();
+
+    if (searchMode == SEARCH_BIDIRECTIONAL){
+        bidirectional_search();
+        return;
+    }
+
+    if (epsStart > 1 || maxTime > 0 || maxExpansions > 0){
+        anytime_search();
+        return;
+    }
+
+    seed_search();
+
+    while (!queue_empty()){
+        int ind = expand_next();
+        if (ind >= 0){
+            goalInd = ind;
+            break;
         }
-        else{
-            explore_diagonal(node);
-        }
+    }
+}
+
+/**********************************************************************
+  Counters of the last call to JPS(), to compare heuristics and search
+  modes. multiGoalSearch fills in the same counters, except the time.
+***********************************************************************/
+JPSStats JPSPlan::get_stats() const{
+    JPSStats stats;
+    stats.pushes = numPushes;
+    stats.pops = numExpansions;
+    stats.cellsScanned = numScanned;
+    stats.closedHits = numClosedHits;
+    stats.time = searchTime;
+    return stats;
+}
 
+#ifdef JPS_TRACE
+std::vector<Eigen::Vector2d> JPSPlan::getTrace(){
+    std::vector<Eigen::Vector2d> trace;
+    trace.reserve(traceCells.size());
+    for(size_t i = 0; i < traceCells.size(); i++){
+        double x, y;
+        mapToWorld(traceCells[i] % sizeX, traceCells[i] / sizeX, x, y);
+        trace.push_back(Eigen::Vector2d(x, y));
     }
+    return trace;
 }
+#endif
 
 /**********************************************************************
   This function goes through the parents[] field and finds the path 
@@ -409,15 +932,18 @@ std::vector<Eigen::Vector2d> JPSPlan::getPath(bool simplify){
     x = goalInd - y*sizeX;
     ret.push_back(Eigen::Vector2d(x,y));
 
-    int i = parents[goalInd];
+    int i = get_parent(goalInd);
     int j = 0;
 
+    if (i < 0)
+        return std::vector<Eigen::Vector2d>();
+
     while(i != startY*sizeX + startX && j++ < 1000){
         //std::cout << "(" << i-((int)(i/sizeX))*sizeX << "," << i/sizeX << ") -->";
         y = i/sizeX;
         x = i - y*sizeX;
         ret.push_back(Eigen::Vector2d(x,y));
-        i = parents[i];
+        i = get_parent(i);
     }
 
     //std::cout << "(" << i-((int)(i/sizeX))*sizeX << "," << i/sizeX << ")\n";
@@ -426,6 +952,20 @@ std::vector<Eigen::Vector2d> JPSPlan::getPath(bool simplify){
     ret.push_back(Eigen::Vector2d(x,y));
     std::reverse(ret.begin(), ret.end());
 
+    return finish_path(ret, simplify);
+}
+
+/**********************************************************************
+  Optionally simplify a path of grid cells, then convert it to world
+  coordinates.
+
+  Inputs:
+    - ret: path in grid cell coordinates, from start to goal
+    - simplify: whether to remove the corners around obstacles and 
+      collinear points
+***********************************************************************/
+std::vector<Eigen::Vector2d> JPSPlan::finish_path(std::vector<Eigen::Vector2d> ret, bool simplify){
+
     if (simplify){
         
         ret = simplifyPath(ret);
@@ -465,18 +1005,132 @@ std::vector<Eigen::Vector2d> JPSPlan::getPath(bool simplify){
   Traditionally these maps are stored as unsigned char* but in the case
   that there are negative numbers, change to signed char* or int* array.
 
+  The JPSPlan object is meant to be kept around between planning 
+  cycles, so the per-cell search buffers are only reallocated when the
+  dimensions of the map change. The blocked mask is built here when the
+  map, its dimensions or its origin change, cells changed in the same
+  map have to be reported through update_map before searching.
+
   Inputs:
     - map in which grid search will be performed on
     - size of the map in both the x and y directions
 ***********************************************************************/
 void JPSPlan::set_map(unsigned char* map, int sizeX, int sizeY, 
                       double originX, double originY, double resolution){
+    if (sizeX*sizeY != (int) parents.size())
+        resize_buffers(sizeX*sizeY);
+
+    // cells keep their index only while the size and placement stay 
+    // the same (a rolling window moves its origin)
+    bool moved = sizeX != this->sizeX || sizeY != this->sizeY ||
+                 originX != this->originX || originY != this->originY ||
+                 resolution != this->resolution;
+    bool changed = map != _map || moved;
+    if (changed){
+        tablesValid = false;
+        incValid = false;
+        losValid = false;
+    }
+
+    if (landmarks && (moved || landmarks->size_x() != sizeX || landmarks->size_y() != sizeY))
+        landmarks.reset();
+
+    if (moved)
+        clearPathCache();
+
     this->_map = map;
     this->sizeX = sizeX;
     this->sizeY = sizeY;
     this->originX = originX;
     this->originY = originY;
     this->resolution = resolution;
+
+    if (changed)
+        build_blocked_mask();
+}
+
+/**********************************************************************
+  Evaluate the blocked rule (see set_cost_threshold) for every cell of
+  the map.
+***********************************************************************/
+void JPSPlan::build_blocked_mask(){
+    int cells = sizeX*sizeY;
+    blockedMask.resize(cells);
+    for(int i = 0; i < cells; i++)
+        blockedMask[i] = blockedLut[_map[i]];
+
+    if (landmarks)
+        drop_stale_landmarks(0, sizeX, 0, sizeY);
+}
+
+/**********************************************************************
+  Evaluate the blocked rule again for the cells inside [x0,xn) x 
+  [y0,yn) (see update_map).
+***********************************************************************/
+void JPSPlan::update_blocked_mask(int x0, int xn, int y0, int yn){
+    for(int y = y0; y < yn; y++)
+        for(int x = x0; x < xn; x++)
+            blockedMask[y*sizeX + x] = blockedLut[_map[y*sizeX + x]];
+}
+
+/**********************************************************************
+  Drop the landmarks if a cell inside [x0,xn) x [y0,yn) they were built
+  with as blocked is free now, since cells may have been connected.
+***********************************************************************/
+void JPSPlan::drop_stale_landmarks(int x0, int xn, int y0, int yn){
+    for(int y = y0; y < yn && landmarks; y++)
+        for(int x = x0; x < xn; x++)
+            if (landmarks->was_blocked(y*sizeX + x) && !blocked(y*sizeX + x)){
+                std::cerr << "map changed, no longer using landmarks" << std::endl;
+                landmarks.reset();
+                break;
+            }
+}
+
+/**********************************************************************
+  This function tells the planner that cells inside [x0,xn) x [y0,yn)
+  may have changed, e.g. the bounds of the last costmap update, so the
+  blocked mask and the data precomputed for the JPS+ and block scan 
+  modes can be patched instead of rebuilt. Landmarks are dropped if a
+  cell they were built with as blocked became free, since cells may 
+  have been connected. In the incremental search mode the changed cells
+  are queued for repair on the next call to JPS(). The line of sight
+  distance field is patched as well once it has been built, and the
+  segments of the cached path over these cells are marked for a new
+  check.
+
+  Inputs:
+    - x0, xn: first and one past last column of the region
+    - y0, yn: first and one past last row of the region
+***********************************************************************/
+void JPSPlan::update_map(int x0, int xn, int y0, int yn){
+
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    xn = std::min(xn, sizeX);
+    yn = std::min(yn, sizeY);
+
+    update_blocked_mask(x0, xn, y0, yn);
+
+    if (landmarks)
+        drop_stale_landmarks(x0, xn, y0, yn);
+
+    if (losValid)
+        update_los_field(x0, xn, y0, yn);
+
+    mark_cache_dirty(x0, xn, y0, yn);
+
+    // patched in every search mode, they are used again once the mode
+    // switches back from the incremental search
+    if (tablesValid){
+        if (scanMode == SCAN_JPS_PLUS)
+            update_jump_tables(x0, xn, y0, yn);
+        else if (scanMode == SCAN_BLOCK)
+            update_block_bits(x0, xn, y0, yn);
+    }
+
+    if (searchMode == SEARCH_INCREMENTAL && incValid)
+        update_incremental(x0, xn, y0, yn);
 }
 
 /**********************************************************************
@@ -505,7 +1159,7 @@ std::vector<Eigen::Vector2d> JPSPlan::simplifyPath(const std::vector<Eigen::Vect
 
     double cost1, cost2, cost3;
 
-    if (!isBlocked(pose1, pose2))
+    if (!los_blocked(pose1, pose2))
         cost1 = (pose1 - pose2).norm();
     else
         cost1 = std::numeric_limits<double>::infinity();
@@ -514,12 +1168,12 @@ std::vector<Eigen::Vector2d> JPSPlan::simplifyPath(const std::vector<Eigen::Vect
     {
         pose1 = path[i];
         pose2 = path[i + 1];
-        if (!isBlocked(pose1, pose2))
+        if (!los_blocked(pose1, pose2))
             cost2 = (pose1 - pose2).norm();
         else
             cost2 = std::numeric_limits<double>::infinity();
 
-        if (!isBlocked(prev_pose, pose2))
+        if (!los_blocked(prev_pose, pose2))
             cost3 = (prev_pose - pose2).norm();
         else
             cost3 = std::numeric_limits<double>::infinity();
@@ -625,7 +1279,7 @@ bool JPSPlan::bresenham(unsigned int abs_da, unsigned int abs_db, int error_b, i
         offset += offset_a;
         error_b += abs_db;
         
-        if (_map[offset] == occupied_val){
+        if (blocked(offset)){
             is_hit = true;
             break;
         }
@@ -635,7 +1289,7 @@ bool JPSPlan::bresenham(unsigned int abs_da, unsigned int abs_db, int error_b, i
             error_b -= abs_da;
         }
 
-        if (_map[offset] == occupied_val){
+        if (blocked(offset)){
             is_hit = true;
             break;
         }
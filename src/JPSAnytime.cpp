@@ -0,0 +1,129 @@
+#include <math.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  Anytime weighted jump point search for JPSPlan. A first search with
+  the heuristic scaled by a weight > 1 heads almost straight for the
+  destination and returns a path quickly. The remaining time is spent
+  on searches with lower weights, each from scratch (jump points are
+  cheap to find again, and it keeps the search itself unchanged), and
+  the shortest path so far is kept between them. The whole thing stops
+  once the time or expansion budget runs out, in the middle of a search
+  if needed, so the search stage can't take longer than allowed. If no
+  path has been found by then, the path leads to the expanded cell with
+  the lowest heuristic, which is as close to the destination as the
+  search got.
+***********************************************************************/
+
+/**********************************************************************
+  True if the budget set with set_budget has been used up.
+
+  Inputs:
+    - elapsed: seconds since the start of the search
+    - expansions: nodes expanded since the start of the search
+***********************************************************************/
+bool JPSPlan::out_of_budget(double elapsed, int expansions) const{
+    return (maxTime > 0 && elapsed >= maxTime) ||
+           (maxExpansions > 0 && expansions >= maxExpansions);
+}
+
+/**********************************************************************
+  Run weighted searches from the start to the destination following
+  the epsilon schedule until the budget runs out, then leave the best
+  path found in the parents tree and set goalInd for getPath.
+***********************************************************************/
+void JPSPlan::anytime_search(){
+
+    typedef std::chrono::steady_clock clock;
+    clock::time_point t0 = clock::now();
+
+    int start = startY*sizeX + startX;
+    int pushes = 0;
+    int expansions = 0;
+    int scanned = 0;
+    int closedHits = 0;
+    int bestCost = -1;
+    double bestEps = 0;
+    bool outOfBudget = false;
+
+    anytimeChain.clear();
+    for(double eps = epsStart; !outOfBudget; eps = std::max(eps - epsStep, 1.)){
+
+        // JPS() already reset the state for the first search
+        if (eps != epsStart)
+            begin_search();
+
+        weight = eps;
+        seed_search();
+
+        while (!queue_empty()){
+            double elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+            if (out_of_budget(elapsed, expansions + numExpansions)){
+                outOfBudget = true;
+                break;
+            }
+
+            int ind = expand_next();
+            if (ind >= 0){
+                goalInd = ind;
+                break;
+            }
+        }
+
+        pushes += numPushes;
+        expansions += numExpansions;
+        scanned += numScanned;
+        closedHits += numClosedHits;
+
+        if (goalInd < 0)
+            break;
+
+        // length of the path in grid steps (diagonal steps cost 1 too)
+        int cost = 0;
+        for(int i = goalInd; i != start; ){
+            int p = get_parent(i);
+            cost += std::max(abs(p % sizeX - i % sizeX), abs(p / sizeX - i / sizeX));
+            i = p;
+        }
+
+        if (bestCost < 0 || cost < bestCost){
+            bestCost = cost;
+            bestEps = eps;
+            anytimeChain.clear();
+            for(int i = goalInd; i != start; i = get_parent(i))
+                anytimeChain.push_back(i);
+            anytimeChain.push_back(start);
+        }
+
+        if (eps <= 1 || epsStep <= 0)
+            break;
+    }
+
+    weight = 1;
+
+    if (!anytimeChain.empty()){
+        // rebuild the parents tree of the best path
+        begin_search();
+        for(size_t k = 0; k + 1 < anytimeChain.size(); k++)
+            set_parent(anytimeChain[k], anytimeChain[k+1]);
+        set_parent(start, start);
+        goalInd = anytimeChain[0];
+        pathEps = bestEps;
+    }
+    else if (closestInd >= 0){
+        // nothing reached the destination, lead as close to it as the
+        // first search got (later searches only run after a path)
+        goalInd = closestInd;
+        partialPath = true;
+    }
+
+    numPushes = pushes;
+    numExpansions = expansions;
+    numScanned = scanned;
+    numClosedHits = closedHits;
+}
@@ -0,0 +1,131 @@
+#include <math.h>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  Bidirectional jump point search for JPSPlan. Since the grid is
+  undirected, the backward search is just the forward one with start
+  and destination swapped, so both directions run the same code on
+  their own closed set, parents and open list, which are swapped in
+  and out of JPSPlan's members (swap_direction). The two directions
+  take turns expanding one node each.
+
+  The directions meet when one of them pops a cell which already has a
+  parent in the other one: the straight and diagonal cell scans treat
+  such cells like the destination (see is_target), the JPS+ and block
+  straight jumps only look for the actual destination so with those the
+  meeting happens on popped jump points. The path is then the forward
+  chain from the start to that cell followed by the backward chain from
+  it to the destination.
+***********************************************************************/
+
+/**********************************************************************
+  Swap the per-direction search state with the other direction.
+***********************************************************************/
+void JPSPlan::swap_direction(){
+    closedSet.swap(otherClosed);
+    parentGen.swap(otherParentGen);
+    parents.swap(otherParents);
+    parentCost.swap(otherParentCost);
+    q.swap(otherQ);
+    buckets.swap(otherBuckets);
+    std::swap(bucketMin, otherBucketMin);
+    std::swap(bucketMax, otherBucketMax);
+    std::swap(bucketCount, otherBucketCount);
+    std::swap(startX, destX);
+    std::swap(startY, destY);
+}
+
+/**********************************************************************
+  Turn the two parent trees into a single chain from the start to the
+  destination in the forward parents, which getPath walks. The forward
+  and backward chains through the meeting cell can share cells, in
+  which case they are spliced at the shared cell closest to the
+  destination so the joined chain has no loop.
+
+  Inputs:
+    - meet: flat index of a cell with a parent in both directions
+***********************************************************************/
+void JPSPlan::join_bidirectional(int meet){
+
+    int start = startY*sizeX + startX;
+    int goal = destY*sizeX + destX;
+    int cells = sizeX*sizeY;
+
+    std::vector<int> fwd, bwd;
+    for(int i = meet; i >= 0 && (int) fwd.size() < cells; i = get_parent(i)){
+        fwd.push_back(i);
+        if (i == start)
+            break;
+    }
+
+    for(int i = meet; i >= 0 && (int) bwd.size() < cells;
+        i = otherParentGen[i] == generation ? otherParents[i] : -1){
+        bwd.push_back(i);
+        if (i == goal)
+            break;
+    }
+
+    if (fwd.back() != start || bwd.back() != goal){
+        std::cerr << "bidirectional search could not join its trees" << std::endl;
+        return;
+    }
+
+    int cut = bwd.size()-1;
+    while (std::find(fwd.begin(), fwd.end(), bwd[cut]) == fwd.end())
+        cut--;
+
+    for(int k = cut+1; k < (int) bwd.size(); k++){
+        parents[bwd[k]] = bwd[k-1];
+        parentGen[bwd[k]] = generation;
+    }
+
+    goalInd = goal;
+}
+
+/**********************************************************************
+  Bidirectional counterpart of the search loop in JPS(). Stops as soon
+  as the directions meet, or when either direction runs out of nodes,
+  in which case there is no path (all cells reachable from one end have
+  been looked at without reaching the other).
+***********************************************************************/
+void JPSPlan::bidirectional_search(){
+
+    int cells = sizeX*sizeY;
+    if ((int) otherClosed.size() != cells){
+        otherClosed.assign(cells, 0);
+        otherParentGen.assign(cells, 0);
+        otherParents.assign(cells, -1);
+        otherParentCost.assign(cells, 0);
+    }
+
+    // backward direction: rooted at the destination
+    swap_direction();
+    clear_queue();
+    seed_search();
+    swap_direction();
+
+    seed_search();
+
+    biActive = true;
+    bool forward = true;
+    int meet = -1;
+    while (!queue_empty()){
+        meet = expand_next();
+        if (meet >= 0)
+            break;
+
+        swap_direction();
+        forward = !forward;
+    }
+
+    if (!forward)
+        swap_direction();
+    biActive = false;
+
+    if (meet >= 0)
+        join_bidirectional(meet);
+}
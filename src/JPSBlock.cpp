@@ -0,0 +1,207 @@
+#include <math.h>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  Block-based straight scans for JPSPlan. The blocked cells of the map
+  are packed into bits, once row by row and once column by column
+  (transposed) so that horizontal and vertical scans both walk along
+  contiguous words. A straight jump then looks at 64 cells per step:
+  walls are the set bits of the line itself, forced neighbors are set
+  bits of a side line whose next bit along the direction is clear. The
+  first of either is found with count trailing/leading zeros.
+***********************************************************************/
+
+static inline bool block_bit(const uint64_t* line, int b){
+    return (line[b >> 6] >> (b & 63)) & 1ULL;
+}
+
+/**********************************************************************
+  Set or clear the blocked bit of cell (x,y) in both the row and the
+  transposed (column) bit grids.
+***********************************************************************/
+void JPSPlan::set_block_bit(int x, int y, bool blocked){
+    uint64_t* row = &rowBits[(y+1)*rowWords];
+    uint64_t* col = &colBits[(x+1)*colWords];
+    uint64_t rbit = 1ULL << ((x+1) & 63);
+    uint64_t cbit = 1ULL << ((y+1) & 63);
+
+    if (blocked){
+        row[(x+1) >> 6] |= rbit;
+        col[(y+1) >> 6] |= cbit;
+    } else{
+        row[(x+1) >> 6] &= ~rbit;
+        col[(y+1) >> 6] &= ~cbit;
+    }
+}
+
+/**********************************************************************
+  Build both bit grids from the map. Everything starts out blocked so
+  the padding bits and padding lines around the map act as walls.
+***********************************************************************/
+void JPSPlan::build_block_bits(){
+
+    rowWords = (sizeX + 2 + 63) / 64;
+    colWords = (sizeY + 2 + 63) / 64;
+    rowBits.assign((sizeY+2)*rowWords, ~0ULL);
+    colBits.assign((sizeX+2)*colWords, ~0ULL);
+
+    for(int y = 0; y < sizeY; y++)
+        for(int x = 0; x < sizeX; x++)
+            if (!blocked(y*sizeX + x))
+                set_block_bit(x, y, false);
+
+    tablesValid = true;
+}
+
+/**********************************************************************
+  Refresh the bits of the cells inside [x0,xn) x [y0,yn) (see
+  update_map).
+***********************************************************************/
+void JPSPlan::update_block_bits(int x0, int xn, int y0, int yn){
+    for(int y = y0; y < yn; y++)
+        for(int x = x0; x < xn; x++)
+            set_block_bit(x, y, blocked(y*sizeX + x));
+}
+
+/**********************************************************************
+  Scan a line of bits starting at bit s in direction dir (+1 or -1)
+  until the first bit that is either blocked or has a forced neighbor,
+  i.e. a blocked bit in sideA / sideB whose next bit along dir is free.
+  Thanks to the padding bits the scan always terminates inside the
+  line.
+
+  Inputs:
+    - line: bits of the row / column being scanned
+    - sideA, sideB: bits of the two neighboring rows / columns
+    - words: number of words in each line
+    - s: bit to start scanning from (not included in the scan)
+    - dir: +1 or -1
+
+  Returns:
+    - bit index where the scan stopped, is_wall tells if it stopped
+      because of a blocked bit (otherwise it is a jump point)
+***********************************************************************/
+int JPSPlan::scan_block_line(const uint64_t* line, const uint64_t* sideA, const uint64_t* sideB,
+                             int words, int s, int dir, bool& is_wall) const{
+
+    if (dir > 0){
+        int p = s + 1;
+        uint64_t mask = ~0ULL << (p & 63);
+        for(int w = p >> 6; w < words; w++, mask = ~0ULL){
+            uint64_t nextA = w+1 < words ? sideA[w+1] << 63 : 1ULL << 63;
+            uint64_t nextB = w+1 < words ? sideB[w+1] << 63 : 1ULL << 63;
+            uint64_t forced = (sideA[w] & ~((sideA[w] >> 1) | nextA)) |
+                              (sideB[w] & ~((sideB[w] >> 1) | nextB));
+            uint64_t stop = (line[w] | forced) & mask;
+            if (stop){
+                int b = (w << 6) + __builtin_ctzll(stop);
+                is_wall = block_bit(line, b);
+                return b;
+            }
+        }
+    } else{
+        int p = s - 1;
+        uint64_t mask = (p & 63) == 63 ? ~0ULL : (1ULL << ((p & 63) + 1)) - 1;
+        for(int w = p >> 6; w >= 0; w--, mask = ~0ULL){
+            uint64_t prevA = w > 0 ? sideA[w-1] >> 63 : 1ULL;
+            uint64_t prevB = w > 0 ? sideB[w-1] >> 63 : 1ULL;
+            uint64_t forced = (sideA[w] & ~((sideA[w] << 1) | prevA)) |
+                              (sideB[w] & ~((sideB[w] << 1) | prevB));
+            uint64_t stop = (line[w] | forced) & mask;
+            if (stop){
+                int b = (w << 6) + 63 - __builtin_clzll(stop);
+                is_wall = block_bit(line, b);
+                return b;
+            }
+        }
+    }
+
+    // unreachable, bit 0 and the last bits of every line are set
+    is_wall = true;
+    return s;
+}
+
+/**********************************************************************
+  Block-based version of explore_straight, with the same results: the
+  scan stops at the destination, at the first jump point (which is
+  added to the queue along with its forced neighbors) or at a wall.
+
+  Inputs:
+    - start: JPSNode_t that was popped off the queue.
+
+  Returns:
+    - True if a jump point has been found and added to queue.
+    - False otherwise
+***********************************************************************/
+bool JPSPlan::explore_straight_block(const JPSNode_t& start){
+
+    int dirx = start.dirx;
+    int diry = start.diry;
+    int ind = start.y*sizeX + start.x;
+
+    set_closed(ind);
+
+    // bit positions are offset by one because of the padding bit
+    bool is_wall;
+    int k, goal_k = -1;
+    if (dirx != 0){
+        const uint64_t* row = &rowBits[(start.y+1)*rowWords];
+        int b = scan_block_line(row, row + rowWords, row - rowWords, rowWords,
+                                start.x+1, dirx, is_wall);
+        k = (b - (start.x+1))*dirx;
+        if (destY == start.y)
+            goal_k = (destX - start.x)*dirx;
+    } else{
+        const uint64_t* col = &colBits[(start.x+1)*colWords];
+        int b = scan_block_line(col, col + colWords, col - colWords, colWords,
+                                start.y+1, diry, is_wall);
+        k = (b - (start.y+1))*diry;
+        if (destX == start.x)
+            goal_k = (destY - start.y)*diry;
+    }
+
+    // words read by the scan
+    numScanned += k/64 + 1;
+
+    if (goal_k >= 1 && goal_k <= k){
+        set_parent(destY*sizeX + destX, ind, start.cost + goal_k);
+        add_to_queue(destX, destY, dirx, diry, start.cost + goal_k);
+        return true;
+    }
+
+    if (is_wall)
+        return false;
+
+    int x = start.x + k*dirx;
+    int y = start.y + k*diry;
+    double cost = start.cost + k;
+
+    const uint64_t* row = &rowBits[(y+1)*rowWords];
+    const uint64_t* col = &colBits[(x+1)*colWords];
+
+    if (dirx != 0){
+        const uint64_t* up = row + rowWords;
+        const uint64_t* down = row - rowWords;
+        if (block_bit(up, x+1) && !block_bit(up, x+1+dirx))
+            add_to_queue(x, y, dirx, 1, cost);
+
+        if (block_bit(down, x+1) && !block_bit(down, x+1+dirx))
+            add_to_queue(x, y, dirx, -1, cost);
+    } else{
+        const uint64_t* right = col + colWords;
+        const uint64_t* left = col - colWords;
+        if (block_bit(right, y+1) && !block_bit(right, y+1+diry))
+            add_to_queue(x, y, 1, diry, cost);
+
+        if (block_bit(left, y+1) && !block_bit(left, y+1+diry))
+            add_to_queue(x, y, -1, diry, cost);
+    }
+
+    set_parent(y*sizeX + x, ind, cost);
+    add_to_queue(x, y, dirx, diry, cost);
+    return true;
+}
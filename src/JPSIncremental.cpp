@@ -0,0 +1,287 @@
+#include <math.h>
+#include <limits>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  Incremental search for JPSPlan (D* Lite, Koenig & Likhachev 2002).
+  The search runs backwards from the goal over the 8-connected grid,
+  straight moves cost 1 and diagonal ones sqrt(2), diagonal moves may
+  not cut the corner of a blocked cell. Since g / rhs are costs to the
+  goal, the tree stays valid when the start moves and only the cells
+  whose edges changed (see update_map) need to be repaired, so steady
+  state replans only expand the affected region.
+
+  The result is written into the parents structure as a chain of
+  turning points from the start to the goal, so getPath works exactly
+  as it does after a jump point search.
+***********************************************************************/
+
+static const double INC_INF = std::numeric_limits<double>::infinity();
+static const int inc_dx[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+static const int inc_dy[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+/**********************************************************************
+  Cost of the edge from cell (x,y) to its neighbor (x+dx,y+dy) on the
+  snapshot of the map, infinite if either end is blocked or outside
+  the map, or if a diagonal move would cut a blocked corner.
+***********************************************************************/
+double JPSPlan::inc_cost(int x, int y, int dx, int dy) const{
+    int nx = x + dx;
+    int ny = y + dy;
+    if (nx < 0 || ny < 0 || nx >= sizeX || ny >= sizeY)
+        return INC_INF;
+
+    if (incOcc[y*sizeX + x] || incOcc[ny*sizeX + nx])
+        return INC_INF;
+
+    if (dx == 0 || dy == 0)
+        return 1;
+
+    if (incOcc[y*sizeX + nx] || incOcc[ny*sizeX + x])
+        return INC_INF;
+
+    return M_SQRT2;
+}
+
+/**********************************************************************
+  Octile distance from the current start to the cell, consistent with
+  the edge costs above.
+***********************************************************************/
+double JPSPlan::inc_heuristic(int ind) const{
+    int dx = abs(ind % sizeX - incStart % sizeX);
+    int dy = abs(ind / sizeX - incStart / sizeX);
+    return std::max(dx, dy) + (M_SQRT2 - 1)*std::min(dx, dy);
+}
+
+void JPSPlan::inc_key(int ind, double& k1, double& k2) const{
+    k2 = std::min(incG[ind], incRhs[ind]);
+    k1 = k2 + inc_heuristic(ind) + km;
+}
+
+/**********************************************************************
+  Queue a cell with its current key. Entries are never removed from
+  the heap, instead incOpen and the key stored per cell tell which
+  entry is the live one and the others are skipped when popped.
+***********************************************************************/
+void JPSPlan::inc_push(int ind){
+    JPSIncEntry e;
+    inc_key(ind, e.k1, e.k2);
+    e.ind = ind;
+    incK1[ind] = e.k1;
+    incK2[ind] = e.k2;
+    incOpen[ind] = 1;
+    incQ.push_back(e);
+    std::push_heap(incQ.begin(), incQ.end(), inc_greater);
+    numPushes++;
+}
+
+/**********************************************************************
+  Recompute the one step lookahead (rhs) of a cell from its neighbors
+  and (re)queue it if it became inconsistent.
+***********************************************************************/
+void JPSPlan::inc_update_vertex(int ind){
+    if (ind != incGoal){
+        int x = ind % sizeX;
+        int y = ind / sizeX;
+        double rhs = INC_INF;
+        numScanned += 8;
+        for(int d = 0; d < 8; d++){
+            double c = inc_cost(x, y, inc_dx[d], inc_dy[d]);
+            if (c != INC_INF)
+                rhs = std::min(rhs, c + incG[(y+inc_dy[d])*sizeX + x+inc_dx[d]]);
+        }
+        incRhs[ind] = rhs;
+    }
+
+    incOpen[ind] = 0;
+    if (incG[ind] != incRhs[ind])
+        inc_push(ind);
+}
+
+/**********************************************************************
+  Expand inconsistent cells until the start is consistent and no
+  queued cell has a smaller key, i.e. until g of the start is the cost
+  of the shortest path (infinite if there is none).
+***********************************************************************/
+void JPSPlan::inc_compute(){
+
+    while (!incQ.empty()){
+        const JPSIncEntry& top = incQ.front();
+        if (!incOpen[top.ind] || top.k1 != incK1[top.ind] || top.k2 != incK2[top.ind]){
+            std::pop_heap(incQ.begin(), incQ.end(), inc_greater);
+            incQ.pop_back();
+            numClosedHits++;
+            continue;
+        }
+
+        double s1, s2;
+        inc_key(incStart, s1, s2);
+        bool top_less = top.k1 < s1 || (top.k1 == s1 && top.k2 < s2);
+        if (!top_less && incRhs[incStart] == incG[incStart])
+            break;
+
+        JPSIncEntry u = top;
+        std::pop_heap(incQ.begin(), incQ.end(), inc_greater);
+        incQ.pop_back();
+        numExpansions++;
+
+        double k1, k2;
+        inc_key(u.ind, k1, k2);
+        if (u.k1 < k1 || (u.k1 == k1 && u.k2 < k2)){
+            inc_push(u.ind);
+            continue;
+        }
+
+        int x = u.ind % sizeX;
+        int y = u.ind / sizeX;
+        incOpen[u.ind] = 0;
+
+        if (incG[u.ind] > incRhs[u.ind])
+            incG[u.ind] = incRhs[u.ind];
+        else{
+            incG[u.ind] = INC_INF;
+            inc_update_vertex(u.ind);
+        }
+
+        for(int d = 0; d < 8; d++){
+            int nx = x + inc_dx[d];
+            int ny = y + inc_dy[d];
+            if (nx >= 0 && ny >= 0 && nx < sizeX && ny < sizeY)
+                inc_update_vertex(ny*sizeX + nx);
+        }
+    }
+}
+
+/**********************************************************************
+  Start a new search tree rooted at the goal, on a fresh snapshot of
+  the blocked cells. The buffers keep their memory between rebuilds.
+***********************************************************************/
+void JPSPlan::build_incremental(int start, int goal){
+    int cells = sizeX*sizeY;
+    incG.assign(cells, INC_INF);
+    incRhs.assign(cells, INC_INF);
+    incK1.assign(cells, 0);
+    incK2.assign(cells, 0);
+    incOpen.assign(cells, 0);
+    incOcc.resize(cells);
+    for(int i = 0; i < cells; i++)
+        incOcc[i] = blocked(i);
+
+    incChanged.clear();
+    incQ.clear();
+    incStart = start;
+    incGoal = goal;
+    km = 0;
+
+    incRhs[goal] = 0;
+    inc_push(goal);
+    incValid = true;
+}
+
+/**********************************************************************
+  Compare the cells inside [x0,xn) x [y0,yn) against the snapshot and
+  remember the ones that changed. They are repaired on the next call
+  to JPS(), after the start has been moved (see update_map).
+***********************************************************************/
+void JPSPlan::update_incremental(int x0, int xn, int y0, int yn){
+    for(int y = y0; y < yn; y++)
+        for(int x = x0; x < xn; x++){
+            int ind = y*sizeX + x;
+            uint8_t occ = blocked(ind);
+            if (occ != incOcc[ind]){
+                incOcc[ind] = occ;
+                incChanged.push_back(ind);
+            }
+        }
+}
+
+/**********************************************************************
+  Follow the shortest path from the start down the g values and store
+  its turning points in parents. Among equally good neighbors the one
+  in the current direction of travel is kept, so straight stretches
+  don't turn into staircases.
+***********************************************************************/
+void JPSPlan::extract_incremental_path(int start, int goal){
+
+    set_parent(start, start);
+
+    int cur = start;
+    int last = start;
+    int prev_d = -1;
+    int steps = 0;
+    while (cur != goal){
+        if (steps++ > sizeX*sizeY)
+            return;
+
+        int x = cur % sizeX;
+        int y = cur / sizeX;
+        int best_d = -1;
+        double best = INC_INF;
+        for(int d = 0; d < 8; d++){
+            double c = inc_cost(x, y, inc_dx[d], inc_dy[d]);
+            if (c == INC_INF)
+                continue;
+
+            c += incG[(y+inc_dy[d])*sizeX + x+inc_dx[d]];
+            if (c < best - 1e-9 || (d == prev_d && c < best + 1e-9)){
+                best = c;
+                best_d = d;
+            }
+        }
+
+        if (best_d < 0 || best == INC_INF)
+            return;
+
+        if (prev_d != -1 && best_d != prev_d){
+            set_parent(cur, last);
+            last = cur;
+        }
+
+        cur = (y+inc_dy[best_d])*sizeX + x+inc_dx[best_d];
+        prev_d = best_d;
+    }
+
+    set_parent(goal, last);
+    goalInd = goal;
+}
+
+/**********************************************************************
+  Incremental counterpart of the jump point search in JPS(). The tree
+  is rebuilt when the goal changed or the map was replaced, otherwise
+  the keys are offset by how far the start moved and the cells around
+  every changed cell are repaired before searching.
+***********************************************************************/
+void JPSPlan::incremental_search(){
+
+    int start = startY*sizeX + startX;
+    int goal = destY*sizeX + destX;
+
+    if (!incValid || goal != incGoal)
+        build_incremental(start, goal);
+    else{
+        if (start != incStart){
+            km += inc_heuristic(start);
+            incStart = start;
+        }
+
+        for(size_t i = 0; i < incChanged.size(); i++){
+            int x = incChanged[i] % sizeX;
+            int y = incChanged[i] / sizeX;
+            for(int ny = std::max(y-1, 0); ny <= std::min(y+1, sizeY-1); ny++)
+                for(int nx = std::max(x-1, 0); nx <= std::min(x+1, sizeX-1); nx++)
+                    inc_update_vertex(ny*sizeX + nx);
+        }
+        incChanged.clear();
+    }
+
+    inc_compute();
+
+    if (incG[start] == INC_INF)
+        return;
+
+    extract_incremental_path(start, goal);
+}
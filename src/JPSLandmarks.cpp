@@ -0,0 +1,283 @@
+#include <math.h>
+#include <stdio.h>
+#include <limits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPSLandmarks.h>
+
+const uint16_t JPSLandmarks::UNREACHABLE;
+
+static const char LANDMARK_MAGIC[8] = {'J', 'P', 'S', 'L', 'M', 'K', '0', '1'};
+
+JPSLandmarks::JPSLandmarks(){
+    sizeX = 0;
+    sizeY = 0;
+    hash = 0;
+    memset(rule, 0, sizeof(rule));
+}
+
+/**********************************************************************
+  True if the fields were computed with the same blocked cost values.
+***********************************************************************/
+bool JPSLandmarks::same_rule(const uint8_t* blocked_rule) const{
+    return memcmp(rule, blocked_rule, sizeof(rule)) == 0;
+}
+
+/**********************************************************************
+  Breadth first search from source over the free cells, filling dist
+  (sizeX*sizeY entries) with the number of steps to every cell.
+
+  Returns:
+    - False if a cell is UNREACHABLE or more steps away, which 16 bits
+      can't hold (winding corridors on large maps), dist is incomplete
+***********************************************************************/
+bool JPSLandmarks::bfs(int source, uint16_t* dist) const{
+
+    int cells = sizeX*sizeY;
+    std::fill(dist, dist + cells, UNREACHABLE);
+
+    std::vector<int> frontier;
+    frontier.reserve(cells);
+    frontier.push_back(source);
+    dist[source] = 0;
+
+    for(size_t head = 0; head < frontier.size(); head++){
+        int ind = frontier[head];
+        int x = ind % sizeX;
+        int y = ind / sizeX;
+        if (dist[ind] + 1 >= UNREACHABLE)
+            return false;
+        uint16_t d = dist[ind] + 1;
+
+        for(int ny = std::max(y-1, 0); ny <= std::min(y+1, sizeY-1); ny++)
+            for(int nx = std::max(x-1, 0); nx <= std::min(x+1, sizeX-1); nx++){
+                int n = ny*sizeX + nx;
+                if (!occ[n] && dist[n] == UNREACHABLE){
+                    dist[n] = d;
+                    frontier.push_back(n);
+                }
+            }
+    }
+
+    return true;
+}
+
+/**********************************************************************
+  FNV-1a hash of the blocked cells, used to check that a saved set of
+  fields belongs to the map it is loaded for.
+***********************************************************************/
+uint64_t JPSLandmarks::map_hash(const std::vector<uint8_t>& occ){
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < occ.size(); i++){
+        h ^= occ[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**********************************************************************
+  Name of a file for the fields of a map, made of its size and the hash
+  of its blocked cells, so the fields of different maps can be kept in 
+  the same directory.
+
+  Inputs:
+    - map, sizeX, sizeY, blocked_rule: as for compute
+
+  Returns:
+    - jps_landmarks_<sizeX>x<sizeY>_<hash>.bin
+***********************************************************************/
+std::string JPSLandmarks::file_name(const unsigned char* map, int sizeX, int sizeY,
+                                    const uint8_t* blocked_rule){
+    int cells = sizeX*sizeY;
+    std::vector<uint8_t> map_occ(cells);
+    for(int i = 0; i < cells; i++)
+        map_occ[i] = blocked_rule[map[i]];
+
+    char name[64];
+    snprintf(name, sizeof(name), "jps_landmarks_%dx%d_%016llx.bin", sizeX, sizeY,
+             (unsigned long long) map_hash(map_occ));
+    return name;
+}
+
+/**********************************************************************
+  Pick the landmarks and compute their distance fields. Landmarks are
+  spread out with farthest point selection: the first one is the cell
+  farthest from the first free cell found, every following one is the
+  free cell farthest from all landmarks picked so far. Landmarks on the
+  border of the map give the tightest bounds, which is where this
+  selection tends to put them.
+
+  Inputs:
+    - map, sizeX, sizeY: grid the fields are computed on
+    - blocked_rule: blocked flag of every cost value, as used by the
+      JPSPlan the fields are for (see JPSPlan::get_blocked_rule)
+    - num_landmarks: number of distance fields to compute
+***********************************************************************/
+void JPSLandmarks::compute(const unsigned char* map, int sizeX, int sizeY,
+                           const uint8_t* blocked_rule, int num_landmarks){
+
+    this->sizeX = sizeX;
+    this->sizeY = sizeY;
+    int cells = sizeX*sizeY;
+
+    memcpy(rule, blocked_rule, sizeof(rule));
+    occ.resize(cells);
+    for(int i = 0; i < cells; i++)
+        occ[i] = rule[map[i]];
+    hash = map_hash(occ);
+
+    landmarks.clear();
+    dist.clear();
+
+    int seed = -1;
+    for(int i = 0; i < cells && seed < 0; i++)
+        if (!occ[i])
+            seed = i;
+
+    if (seed < 0 || num_landmarks <= 0)
+        return;
+
+    // distance to the closest landmark so far, starting from the seed
+    std::vector<uint16_t> closest(cells);
+    if (!bfs(seed, closest.data())){
+        std::cerr << "map too large for 16 bit landmark distances, no landmarks built" << std::endl;
+        return;
+    }
+    dist.resize((size_t) num_landmarks*cells);
+
+    for(int k = 0; k < num_landmarks; k++){
+        int best = -1;
+        for(int i = 0; i < cells; i++)
+            if (closest[i] != UNREACHABLE && (best < 0 || closest[i] > closest[best]))
+                best = i;
+
+        if (best < 0 || (k > 0 && closest[best] == 0))
+            break;
+
+        uint16_t* field = &dist[(size_t) k*cells];
+        if (!bfs(best, field)){
+            std::cerr << "map too large for 16 bit landmark distances, no landmarks built" << std::endl;
+            landmarks.clear();
+            dist.clear();
+            return;
+        }
+        landmarks.push_back(best);
+
+        if (k == 0)
+            std::copy(field, field + cells, closest.begin());
+        else
+            for(int i = 0; i < cells; i++)
+                closest[i] = std::min(closest[i], field[i]);
+    }
+
+    dist.resize((size_t) landmarks.size()*cells);
+}
+
+/**********************************************************************
+  Lower bound on the number of steps between two cells.
+
+  Returns:
+    - the largest difference of landmark distances, or infinity if a
+      landmark reaches one of the cells but not the other
+***********************************************************************/
+double JPSLandmarks::lower_bound(int a, int b) const{
+
+    int cells = sizeX*sizeY;
+    int h = 0;
+    for(size_t k = 0; k < landmarks.size(); k++){
+        const uint16_t* field = &dist[k*cells];
+        uint16_t da = field[a];
+        uint16_t db = field[b];
+        if ((da == UNREACHABLE) != (db == UNREACHABLE))
+            return std::numeric_limits<double>::infinity();
+
+        if (da != UNREACHABLE)
+            h = std::max(h, abs((int) da - (int) db));
+    }
+
+    return h;
+}
+
+/**********************************************************************
+  Write the fields to a binary file: a magic string, the map size, the
+  hash of its blocked cells, the landmarks and the fields.
+
+  Returns:
+    - True if the file was written
+***********************************************************************/
+bool JPSLandmarks::save(const std::string& file) const{
+
+    std::ofstream out(file.c_str(), std::ios::binary);
+    if (!out)
+        return false;
+
+    int k = landmarks.size();
+    out.write(LANDMARK_MAGIC, sizeof(LANDMARK_MAGIC));
+    out.write((const char*) &sizeX, sizeof(sizeX));
+    out.write((const char*) &sizeY, sizeof(sizeY));
+    out.write((const char*) &hash, sizeof(hash));
+    out.write((const char*) &k, sizeof(k));
+    out.write((const char*) landmarks.data(), k*sizeof(int));
+    out.write((const char*) dist.data(), dist.size()*sizeof(uint16_t));
+
+    return (bool) out;
+}
+
+/**********************************************************************
+  Read fields written by save, if they were computed on the same map.
+
+  Inputs:
+    - file: file written by save
+    - map, sizeX, sizeY: the map the fields are for
+    - blocked_rule: blocked flag of every cost value (see compute)
+
+  Returns:
+    - True if the fields were loaded, False if the file is missing,
+      unreadable or belongs to a different map
+***********************************************************************/
+bool JPSLandmarks::load(const std::string& file, const unsigned char* map,
+                        int sizeX, int sizeY, const uint8_t* blocked_rule){
+
+    std::ifstream in(file.c_str(), std::ios::binary);
+    if (!in)
+        return false;
+
+    char magic[sizeof(LANDMARK_MAGIC)];
+    int sx, sy, k;
+    uint64_t h;
+    in.read(magic, sizeof(magic));
+    in.read((char*) &sx, sizeof(sx));
+    in.read((char*) &sy, sizeof(sy));
+    in.read((char*) &h, sizeof(h));
+    in.read((char*) &k, sizeof(k));
+    if (!in || memcmp(magic, LANDMARK_MAGIC, sizeof(magic)) != 0 ||
+        sx != sizeX || sy != sizeY || k < 0)
+        return false;
+
+    int cells = sizeX*sizeY;
+    std::vector<uint8_t> map_occ(cells);
+    for(int i = 0; i < cells; i++)
+        map_occ[i] = blocked_rule[map[i]];
+
+    if (map_hash(map_occ) != h)
+        return false;
+
+    std::vector<int> lms(k);
+    std::vector<uint16_t> fields((size_t) k*cells);
+    in.read((char*) lms.data(), k*sizeof(int));
+    in.read((char*) fields.data(), fields.size()*sizeof(uint16_t));
+    if (!in)
+        return false;
+
+    this->sizeX = sizeX;
+    this->sizeY = sizeY;
+    hash = h;
+    memcpy(rule, blocked_rule, sizeof(rule));
+    occ.swap(map_occ);
+    landmarks.swap(lms);
+    dist.swap(fields);
+    return true;
+}
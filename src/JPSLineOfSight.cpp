@@ -0,0 +1,195 @@
+#include <math.h>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  Line of sight queries for JPSPlan backed by a distance field: every
+  cell stores its Chebyshev distance (in cells, capped) to the closest
+  blocked cell. A segment is checked by walking along it like a cell
+  traversal (every cell it touches, including cells it only grazes at
+  a corner), but wherever the field says the closest obstacle is far,
+  the walk jumps ahead by that distance instead of one cell at a time.
+  Segments through open space take a handful of lookups, and near
+  obstacles it is no slower than walking the cells. A clearance margin
+  is the same test with every distance lowered by the margin.
+
+  The field is built on first use and patched by update_map, only
+  around the cells that changed since the distances are capped.
+***********************************************************************/
+
+// largest distance stored in the field, also how far around a changed
+// cell the field has to be recomputed
+static const int LOS_MAX_DIST = 32;
+
+/**********************************************************************
+  Two pass distance transform (8-connected chamfer with unit weights,
+  which is exact for the Chebyshev distance) over [x0,xn) x [y0,yn).
+  Cells outside of the region are read but not written, so they must
+  already hold their final distance.
+***********************************************************************/
+void JPSPlan::los_transform(int x0, int xn, int y0, int yn){
+
+    for(int y = y0; y < yn; y++)
+        for(int x = x0; x < xn; x++){
+            int ind = y*sizeX + x;
+            if (blocked(ind)){
+                losDist[ind] = 0;
+                continue;
+            }
+
+            int d = LOS_MAX_DIST;
+            if (x > 0)
+                d = std::min(d, losDist[ind-1] + 1);
+            if (y > 0){
+                for(int nx = std::max(x-1, 0); nx <= std::min(x+1, sizeX-1); nx++)
+                    d = std::min(d, losDist[ind-sizeX + nx-x] + 1);
+            }
+            losDist[ind] = d;
+        }
+
+    for(int y = yn-1; y >= y0; y--)
+        for(int x = xn-1; x >= x0; x--){
+            int ind = y*sizeX + x;
+            int d = losDist[ind];
+            if (x < sizeX-1)
+                d = std::min(d, losDist[ind+1] + 1);
+            if (y < sizeY-1){
+                for(int nx = std::max(x-1, 0); nx <= std::min(x+1, sizeX-1); nx++)
+                    d = std::min(d, losDist[ind+sizeX + nx-x] + 1);
+            }
+            losDist[ind] = d;
+        }
+}
+
+/**********************************************************************
+  Build the distance field for the whole map.
+***********************************************************************/
+void JPSPlan::build_los_field(){
+    losDist.assign(sizeX*sizeY, LOS_MAX_DIST);
+    los_transform(0, sizeX, 0, sizeY);
+    losValid = true;
+}
+
+/**********************************************************************
+  Refresh the field after the cells inside [x0,xn) x [y0,yn) changed
+  (see update_map). Only cells closer than LOS_MAX_DIST to them can
+  have a different distance, so the transform is redone over the
+  region grown by that much, starting from the distances around it.
+***********************************************************************/
+void JPSPlan::update_los_field(int x0, int xn, int y0, int yn){
+    if (x0 >= xn || y0 >= yn)
+        return;
+
+    x0 = std::max(x0 - LOS_MAX_DIST, 0);
+    y0 = std::max(y0 - LOS_MAX_DIST, 0);
+    xn = std::min(xn + LOS_MAX_DIST, sizeX);
+    yn = std::min(yn + LOS_MAX_DIST, sizeY);
+
+    for(int y = y0; y < yn; y++)
+        std::fill(&losDist[y*sizeX + x0], &losDist[y*sizeX + xn], LOS_MAX_DIST);
+
+    los_transform(x0, xn, y0, yn);
+}
+
+/**********************************************************************
+  Check a segment between two points in continuous cell coordinates
+  (cell (x,y) spans [x,x+1) x [y,y+1)) against the distance field.
+***********************************************************************/
+bool JPSPlan::los_segment_blocked(double ax, double ay, double bx, double by) const{
+
+    double dx = bx - ax;
+    double dy = by - ay;
+    double len = std::max(fabs(dx), fabs(dy));
+    int stepX = dx > 0 ? 1 : -1;
+    int stepY = dy > 0 ? 1 : -1;
+    int ex = (int) floor(bx);
+    int ey = (int) floor(by);
+
+    // change of the segment parameter between two cell borders
+    double deltaX = dx == 0 ? 2 : stepX / dx;
+    double deltaY = dy == 0 ? 2 : stepY / dy;
+
+    // s is where the walk entered the current cell along the segment,
+    // nextX / nextY where it crosses the next border along x / y
+    double s = 0;
+    int cx = (int) floor(ax);
+    int cy = (int) floor(ay);
+    double nextX = dx == 0 ? 2 : (cx + (dx > 0) - ax) / dx;
+    double nextY = dy == 0 ? 2 : (cy + (dy > 0) - ay) / dy;
+    while (true){
+        int d = losDist[cy*sizeX + cx];
+        if (d <= losMargin)
+            return true;
+
+        if (cx == ex && cy == ey)
+            return false;
+
+        // every cell within d-1 of this one keeps the margin, and moving
+        // the point by k stays within k+1 cells of it
+        int jump = d - losMargin - 2;
+        if (jump >= 1){
+            s += jump / len;
+            if (s >= 1)
+                return false;
+
+            cx = (int) floor(ax + s*dx);
+            cy = (int) floor(ay + s*dy);
+            nextX = dx == 0 ? 2 : (cx + (dx > 0) - ax) / dx;
+            nextY = dy == 0 ? 2 : (cy + (dy > 0) - ay) / dy;
+            continue;
+        }
+
+        // otherwise step to the next cell the segment enters, checking
+        // both side cells when it goes exactly through a corner
+        if (fabs(nextX - nextY) < 1e-9){
+            if (nextX > 1)
+                return false;
+            if (losDist[cy*sizeX + cx+stepX] <= losMargin ||
+                losDist[(cy+stepY)*sizeX + cx] <= losMargin)
+                return true;
+            cx += stepX;
+            cy += stepY;
+            s = nextX;
+            nextX += deltaX;
+            nextY += deltaY;
+        } else if (nextX < nextY){
+            if (nextX > 1)
+                return false;
+            cx += stepX;
+            s = nextX;
+            nextX += deltaX;
+        } else{
+            if (nextY > 1)
+                return false;
+            cy += stepY;
+            s = nextY;
+            nextY += deltaY;
+        }
+    }
+}
+
+/**********************************************************************
+  Line of sight test used by simplifyPath and the any-angle search:
+  Bresenham over the grid (isBlocked) in LOS_BRESENHAM mode, the
+  distance field in LOS_DISTANCE mode.
+
+  Inputs:
+    - p1, p2: end points of the segment, in grid cell coordinates
+
+  Returns:
+    - True if the segment is blocked
+***********************************************************************/
+bool JPSPlan::los_blocked(const Eigen::Vector2d& p1, const Eigen::Vector2d& p2){
+
+    if (losMode == LOS_BRESENHAM)
+        return isBlocked(p1, p2);
+
+    if (!losValid)
+        build_los_field();
+
+    // segment between the cell centers
+    return los_segment_blocked(p1[0] + .5, p1[1] + .5, p2[0] + .5, p2[1] + .5);
+}
@@ -0,0 +1,218 @@
+#include <math.h>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  One-to-many queries for JPSPlan. Instead of one search per candidate
+  goal, a single breadth first search from the start (every step costs
+  1, as in the jump point search) settles all candidates at once and
+  leaves a parents tree from which the path to any of them can be read
+  with getPathTo.
+***********************************************************************/
+
+/**********************************************************************
+  Search from the start to many goals at once. The search stops when
+  every goal has been reached, when there is nothing left to explore
+  or when max_cost has been exceeded.
+
+  Inputs:
+    - goals: goal cells, in grid cell coordinates
+    - max_cost: highest cost to search up to, -1 for no limit
+
+  Outputs:
+    - costs: cost from the start to every goal, -1 if not reached
+
+  Returns:
+    - number of goals reached
+***********************************************************************/
+int JPSPlan::multiGoalSearch(const std::vector<Eigen::Vector2i>& goals, std::vector<int>& costs,
+                             int max_cost){
+
+    begin_search();
+    costs.assign(goals.size(), -1);
+
+    // goal cells sorted by flat index, with the goal they came from
+    std::vector<std::pair<int, int> > targets;
+    for(size_t i = 0; i < goals.size(); i++){
+        int x = goals[i][0];
+        int y = goals[i][1];
+        if (x >= 0 && y >= 0 && x < sizeX && y < sizeY && !blocked(y*sizeX + x))
+            targets.push_back(std::make_pair(y*sizeX + x, (int) i));
+    }
+    std::sort(targets.begin(), targets.end());
+
+    int start = startY*sizeX + startX;
+    if (targets.empty() || blocked(start))
+        return 0;
+
+    int remaining = targets.size();
+    int reached = 0;
+
+    bfsQueue.clear();
+    bfsQueue.push_back(start);
+    set_closed(start);
+    set_parent(start, start);
+
+    int depth = 0;
+    size_t layer_end = 1;
+    for(size_t head = 0; head < bfsQueue.size() && remaining > 0; head++){
+        if (head == layer_end){
+            depth++;
+            layer_end = bfsQueue.size();
+            if (max_cost >= 0 && depth > max_cost)
+                break;
+        }
+
+        int ind = bfsQueue[head];
+        numExpansions++;
+
+        std::vector<std::pair<int, int> >::iterator it =
+            std::lower_bound(targets.begin(), targets.end(), std::make_pair(ind, -1));
+        for(; it != targets.end() && it->first == ind; ++it){
+            costs[it->second] = depth;
+            remaining--;
+            reached++;
+        }
+
+        int x = ind % sizeX;
+        int y = ind / sizeX;
+        for(int ny = std::max(y-1, 0); ny <= std::min(y+1, sizeY-1); ny++)
+            for(int nx = std::max(x-1, 0); nx <= std::min(x+1, sizeX-1); nx++){
+                int n = ny*sizeX + nx;
+                numScanned++;
+                if (!is_closed(n) && !blocked(n)){
+                    set_closed(n);
+                    set_parent(n, ind);
+                    bfsQueue.push_back(n);
+                    numPushes++;
+                }
+            }
+    }
+
+    return reached;
+}
+
+/**********************************************************************
+  Path from the start to any cell reached by the last search, e.g. one
+  of the goals of multiGoalSearch. Straight runs of cells are reduced
+  to their end points before the path goes through the same
+  post-processing as getPath.
+
+  Inputs:
+    - x, y: grid cell to get the path to
+    - simplify: same as for getPath
+
+  Returns:
+    - path in world coordinates, empty if the cell wasn't reached
+***********************************************************************/
+std::vector<Eigen::Vector2d> JPSPlan::getPathTo(int x, int y, bool simplify){
+
+    std::vector<Eigen::Vector2d> ret;
+    if (x < 0 || y < 0 || x >= sizeX || y >= sizeY)
+        return ret;
+
+    int start = startY*sizeX + startX;
+    int i = y*sizeX + x;
+    int n = 0;
+    while (i >= 0 && n++ <= sizeX*sizeY){
+        Eigen::Vector2d p(i % sizeX, i / sizeX);
+
+        // drop the previous point if it is in line with its neighbors
+        if (ret.size() >= 2){
+            Eigen::Vector2d d = (p - ret.back()) - (ret.back() - ret[ret.size()-2]);
+            if (fabs(d[0]) + fabs(d[1]) <= 1e-2)
+                ret.pop_back();
+        }
+        ret.push_back(p);
+
+        if (i == start)
+            break;
+        i = get_parent(i);
+    }
+
+    if (i != start)
+        return std::vector<Eigen::Vector2d>();
+
+    std::reverse(ret.begin(), ret.end());
+    return finish_path(ret, simplify);
+}
+
+/**********************************************************************
+  Append the free cells on the square ring of radius r around (x,y) to
+  cells, only those reached by the last search if reached is set.
+***********************************************************************/
+void JPSPlan::ring_cells(int x, int y, int r, bool reached, 
+                         std::vector<Eigen::Vector2i>& cells) const{
+    for(int cy = y-r; cy <= y+r; cy++){
+        if (cy < 0 || cy >= sizeY)
+            continue;
+
+        // whole rows at the top and bottom of the ring, only the two
+        // end cells in between
+        int step = (cy == y-r || cy == y+r) ? 1 : std::max(2*r, 1);
+        for(int cx = x-r; cx <= x+r; cx += step){
+            int ind = cy*sizeX + cx;
+            if (cx >= 0 && cx < sizeX && !blocked(ind) && (!reached || is_closed(ind)))
+                cells.push_back(Eigen::Vector2i(cx, cy));
+        }
+    }
+}
+
+/**********************************************************************
+  Free cells closest to (x,y), which may be blocked or even outside of
+  the map: looks at square rings of growing radius around it and
+  returns all free cells of the first ring that has any.
+
+  Inputs:
+    - x, y: grid cell to search around
+    - max_radius: largest ring to look at
+
+  Outputs:
+    - cells: the free cells found
+
+  Returns:
+    - radius of the ring they were found on, -1 if none was found
+***********************************************************************/
+int JPSPlan::nearestFree(int x, int y, int max_radius, std::vector<Eigen::Vector2i>& cells){
+
+    cells.clear();
+    for(int r = 0; r <= max_radius; r++){
+        ring_cells(x, y, r, false, cells);
+        if (!cells.empty())
+            return r;
+    }
+
+    return -1;
+}
+
+/**********************************************************************
+  Same as nearestFree, but only for cells reached by the last search.
+  After a multiGoalSearch that reached none of its goals, which has
+  gone through every cell reachable from the start, these are the 
+  closest reachable cells.
+
+  Inputs:
+    - x, y: grid cell to search around
+    - min_radius, max_radius: rings to look at
+
+  Outputs:
+    - cells: the reached cells found
+
+  Returns:
+    - radius of the ring they were found on, -1 if none was found
+***********************************************************************/
+int JPSPlan::nearestReached(int x, int y, int min_radius, int max_radius, 
+                            std::vector<Eigen::Vector2i>& cells){
+
+    cells.clear();
+    for(int r = std::max(min_radius, 0); r <= max_radius; r++){
+        ring_cells(x, y, r, true, cells);
+        if (!cells.empty())
+            return r;
+    }
+
+    return -1;
+}
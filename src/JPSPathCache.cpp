@@ -0,0 +1,159 @@
+#include <math.h>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  Path reuse for JPSPlan. The last path is kept in grid cell
+  coordinates together with the destination it was planned to, and
+  every segment remembers whether a cell in its bounding box was
+  reported as changed by update_map since it was last checked. On the
+  next cycle only those segments get a new line of sight check: if
+  they are all still clear and the start has only moved along the
+  path, the rest of the path from the start is returned and no search
+  is needed.
+
+  A reused path only ever gets checked for being blocked, so a shorter
+  route opening up elsewhere would never be found: the search runs
+  again after a number of reuses.
+***********************************************************************/
+
+/**********************************************************************
+  Keep a path returned by getPath for reuse on later cycles.
+
+  Inputs:
+    - path: path in world coordinates, from the start to the current
+      destination
+***********************************************************************/
+void JPSPlan::cachePath(const std::vector<Eigen::Vector2d>& path){
+
+    cachePoints.clear();
+    cacheDirty.clear();
+    for(size_t i = 0; i < path.size(); i++){
+        unsigned int mx, my;
+        if (!worldToMap(path[i][0], path[i][1], mx, my)){
+            clearPathCache();
+            return;
+        }
+        cachePoints.push_back(Eigen::Vector2d(mx, my));
+    }
+
+    if (cachePoints.size() < 2){
+        clearPathCache();
+        return;
+    }
+
+    cacheDirty.assign(cachePoints.size()-1, 0);
+    cacheDest = destY*sizeX + destX;
+    cacheReuses = 0;
+}
+
+/**********************************************************************
+  Drop the cached path.
+***********************************************************************/
+void JPSPlan::clearPathCache(){
+    cachePoints.clear();
+    cacheDirty.clear();
+    cacheDest = -1;
+}
+
+/**********************************************************************
+  Mark the cached segments whose bounding box overlaps the cells inside
+  [x0,xn) x [y0,yn) (see update_map) for a new line of sight check. The
+  box is grown by the line of sight margin, since a segment is also
+  blocked by cells that close to it.
+***********************************************************************/
+void JPSPlan::mark_cache_dirty(int x0, int xn, int y0, int yn){
+    if (x0 >= xn || y0 >= yn)
+        return;
+
+    x0 -= losMargin;
+    xn += losMargin;
+    y0 -= losMargin;
+    yn += losMargin;
+
+    for(size_t i = 0; i < cacheDirty.size(); i++){
+        const Eigen::Vector2d& a = cachePoints[i];
+        const Eigen::Vector2d& b = cachePoints[i+1];
+        if (std::max(a[0], b[0]) >= x0 && std::min(a[0], b[0]) < xn &&
+            std::max(a[1], b[1]) >= y0 && std::min(a[1], b[1]) < yn)
+            cacheDirty[i] = 1;
+    }
+}
+
+/**********************************************************************
+  Try to reuse the cached path from the current start to the current
+  destination. The start has to be within tolerance of the path and
+  see the first vertex ahead of it, and every segment that may have
+  changed has to still be clear. The cache is dropped otherwise, or once
+  it has been reused max_reuses times, and trimmed to the returned path
+  if it was reused.
+
+  Inputs:
+    - tolerance: largest distance, in cells, from the start to the
+      cached path
+    - max_reuses: reuses of a path before searching again, 0 for no
+      limit
+
+  Outputs:
+    - path: the reused path in world coordinates
+
+  Returns:
+    - True if the cached path could be reused
+***********************************************************************/
+bool JPSPlan::reusePath(std::vector<Eigen::Vector2d>& path, double tolerance, int max_reuses){
+
+    if (cachePoints.empty() || cacheDest != destY*sizeX + destX)
+        return false;
+
+    if (max_reuses > 0 && cacheReuses >= max_reuses){
+        clearPathCache();
+        return false;
+    }
+
+    for(size_t i = 0; i < cacheDirty.size(); i++){
+        if (cacheDirty[i] && los_blocked(cachePoints[i], cachePoints[i+1])){
+            clearPathCache();
+            return false;
+        }
+        cacheDirty[i] = 0;
+    }
+
+    // segment closest to the start
+    Eigen::Vector2d start(startX, startY);
+    int best = -1;
+    double bestDist = 0;
+    for(size_t i = 0; i + 1 < cachePoints.size(); i++){
+        Eigen::Vector2d a = cachePoints[i];
+        Eigen::Vector2d d = cachePoints[i+1] - a;
+        double t = d.squaredNorm() > 0 ? (start - a).dot(d) / d.squaredNorm() : 0;
+        t = std::min(std::max(t, 0.), 1.);
+
+        double dist = (a + t*d - start).norm();
+        if (best < 0 || dist < bestDist){
+            best = i;
+            bestDist = dist;
+        }
+    }
+
+    if (bestDist > tolerance || los_blocked(start, cachePoints[best+1])){
+        clearPathCache();
+        return false;
+    }
+
+    cachePoints.erase(cachePoints.begin(), cachePoints.begin() + best);
+    cacheDirty.erase(cacheDirty.begin(), cacheDirty.begin() + best);
+    cachePoints[0] = start;
+    cacheReuses++;
+
+    path.clear();
+    for(size_t i = 0; i < cachePoints.size(); i++){
+        double x, y;
+        mapToWorld(cachePoints[i][0], cachePoints[i][1], x, y);
+        path.push_back(Eigen::Vector2d(x, y));
+    }
+
+    return true;
+}
@@ -0,0 +1,403 @@
+#include <math.h>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  JPS+ for JPSPlan. For every cell and each of the 8 directions the
+  jump which explore_straight / explore_diagonal would perform from
+  that cell is precomputed and stored in jumpDist:
+
+    d > 0   : the d-th cell along the direction is a jump point
+    d <= 0  : no jump point, -d free cells before a wall / the border
+
+  The tables only depend on which cells are blocked, so they are built
+  once per map and patched through update_map() when cells change. The
+  goal is not part of the tables and is checked for during the search.
+***********************************************************************/
+
+/**********************************************************************
+  Blocked test against the snapshot the tables were built from. Cells
+  outside the map count as blocked.
+***********************************************************************/
+bool JPSPlan::cell_blocked(int x, int y) const{
+    if (x < 0 || y < 0 || x >= sizeX || y >= sizeY)
+        return true;
+
+    return tableOcc[y*sizeX + x];
+}
+
+/**********************************************************************
+  Same forced neighbor rule as explore_straight: a cell reached while
+  moving in a cardinal direction is a jump point if a side neighbor is
+  blocked but the cell diagonally ahead of it is free.
+***********************************************************************/
+bool JPSPlan::straight_forced(int x, int y, int dirx, int diry) const{
+    if (dirx != 0)
+        return (cell_blocked(x, y+1) && !cell_blocked(x+dirx, y+1)) ||
+               (cell_blocked(x, y-1) && !cell_blocked(x+dirx, y-1));
+
+    return (cell_blocked(x+1, y) && !cell_blocked(x+1, y+diry)) ||
+           (cell_blocked(x-1, y) && !cell_blocked(x-1, y+diry));
+}
+
+/**********************************************************************
+  A cell reached while moving diagonally is a jump point if it has a
+  forced neighbor (same rule as explore_diagonal) or if either of the
+  straight scans kicked off from it finds a jump point.
+***********************************************************************/
+bool JPSPlan::diagonal_jump(int x, int y, int dirx, int diry) const{
+    int px = x - dirx;
+    int py = y - diry;
+
+    if ((cell_blocked(px, y) && !cell_blocked(px, y+diry)) ||
+        (cell_blocked(x, py) && !cell_blocked(x+dirx, py)))
+        return true;
+
+    int ind = (y*sizeX + x)*8;
+    return jumpDist[ind + dir_index(dirx, 0)] > 0 ||
+           jumpDist[ind + dir_index(0, diry)] > 0;
+}
+
+/**********************************************************************
+  Computes the jump distance of cell (x,y) in direction (dirx,diry)
+  from the entry of the next cell along that direction, which must
+  already be up to date.
+***********************************************************************/
+int JPSPlan::next_jump_dist(int x, int y, int dirx, int diry) const{
+    int nx = x + dirx;
+    int ny = y + diry;
+
+    if (cell_blocked(nx, ny))
+        return 0;
+
+    bool is_jump = (dirx == 0 || diry == 0) ? straight_forced(nx, ny, dirx, diry)
+                                            : diagonal_jump(nx, ny, dirx, diry);
+    if (is_jump)
+        return 1;
+
+    int d = jumpDist[(ny*sizeX + nx)*8 + dir_index(dirx, diry)];
+    return d > 0 ? d+1 : d-1;
+}
+
+/**********************************************************************
+  Recompute the east / west jump distances of a whole row.
+***********************************************************************/
+void JPSPlan::update_straight_row(int y){
+    for(int x = sizeX-1; x >= 0; x--)
+        jumpDist[(y*sizeX + x)*8 + dir_index(1,0)] = next_jump_dist(x, y, 1, 0);
+
+    for(int x = 0; x < sizeX; x++)
+        jumpDist[(y*sizeX + x)*8 + dir_index(-1,0)] = next_jump_dist(x, y, -1, 0);
+}
+
+/**********************************************************************
+  Recompute the north / south jump distances of a whole column.
+***********************************************************************/
+void JPSPlan::update_straight_col(int x){
+    for(int y = sizeY-1; y >= 0; y--)
+        jumpDist[(y*sizeX + x)*8 + dir_index(0,1)] = next_jump_dist(x, y, 0, 1);
+
+    for(int y = 0; y < sizeY; y++)
+        jumpDist[(y*sizeX + x)*8 + dir_index(0,-1)] = next_jump_dist(x, y, 0, -1);
+}
+
+/**********************************************************************
+  Recompute the diagonal jump distances affected by a change of the 
+  straight entries in rows [r0,r1] and columns [c0,c1]. Rows are 
+  visited in dependency order (furthest along the diagonal first). 
+  Inside the row band every cell is recomputed, outside of it only 
+  cells in the column band and cells whose successor along the 
+  diagonal just changed value, so a change only ripples back along a
+  diagonal until it hits a wall or a jump point.
+
+  Inputs:
+    - r0, r1: rows whose straight entries changed
+    - c0, c1: columns whose straight entries changed
+***********************************************************************/
+void JPSPlan::update_diagonals(int r0, int r1, int c0, int c1){
+    static const int dirs[4][2] = {{1,1}, {1,-1}, {-1,1}, {-1,-1}};
+
+    // columns whose entry changed in the previous / current row
+    std::vector<int> changed, next;
+    changed.reserve(sizeX);
+    next.reserve(sizeX);
+
+    for(int d = 0; d < 4; d++){
+        int dirx = dirs[d][0];
+        int diry = dirs[d][1];
+        int di = dir_index(dirx, diry);
+
+        changed.clear();
+        for(int j = 0; j < sizeY; j++){
+            int y = diry > 0 ? sizeY-1-j : j;
+            next.clear();
+
+            if (y >= r0 && y <= r1){
+                for(int x = 0; x < sizeX; x++){
+                    int& entry = jumpDist[(y*sizeX + x)*8 + di];
+                    int val = next_jump_dist(x, y, dirx, diry);
+                    if (val != entry){
+                        entry = val;
+                        next.push_back(x);
+                    }
+                }
+            }
+            else{
+                for(int x = c0; x <= c1; x++){
+                    int& entry = jumpDist[(y*sizeX + x)*8 + di];
+                    int val = next_jump_dist(x, y, dirx, diry);
+                    if (val != entry){
+                        entry = val;
+                        next.push_back(x);
+                    }
+                }
+
+                for(int i = 0; i < (int) changed.size(); i++){
+                    int x = changed[i] - dirx;
+                    if (x < 0 || x >= sizeX || (x >= c0 && x <= c1))
+                        continue;
+
+                    int& entry = jumpDist[(y*sizeX + x)*8 + di];
+                    int val = next_jump_dist(x, y, dirx, diry);
+                    if (val != entry){
+                        entry = val;
+                        next.push_back(x);
+                    }
+                }
+            }
+
+            std::swap(changed, next);
+        }
+    }
+}
+
+/**********************************************************************
+  Build the jump distance tables for the whole map. Straight tables
+  are built first since the diagonal ones depend on them.
+***********************************************************************/
+void JPSPlan::build_jump_tables(){
+
+    int cells = sizeX*sizeY;
+    tableOcc.resize(cells);
+    jumpDist.assign(cells*8, 0);
+
+    for(int i = 0; i < cells; i++)
+        tableOcc[i] = blocked(i);
+
+    for(int y = 0; y < sizeY; y++)
+        update_straight_row(y);
+
+    for(int x = 0; x < sizeX; x++)
+        update_straight_col(x);
+
+    update_diagonals(0, sizeY-1, 0, sizeX-1);
+
+    tablesValid = true;
+}
+
+/**********************************************************************
+  Patch the jump tables after cells inside [x0,xn) x [y0,yn) may have
+  changed (see update_map). The region is compared against the 
+  snapshot the tables were built from and only the rows and columns
+  around cells which actually changed are recomputed.
+
+  Inputs:
+    - x0, xn: first and one past last column of the region
+    - y0, yn: first and one past last row of the region
+***********************************************************************/
+void JPSPlan::update_jump_tables(int x0, int xn, int y0, int yn){
+
+    int cx0 = sizeX, cx1 = -1, cy0 = sizeY, cy1 = -1;
+    for(int y = y0; y < yn; y++){
+        for(int x = x0; x < xn; x++){
+            uint8_t occ = blocked(y*sizeX + x);
+            if (occ == tableOcc[y*sizeX + x])
+                continue;
+
+            tableOcc[y*sizeX + x] = occ;
+            cx0 = std::min(cx0, x);
+            cx1 = std::max(cx1, x);
+            cy0 = std::min(cy0, y);
+            cy1 = std::max(cy1, y);
+        }
+    }
+
+    if (cx1 < 0)
+        return;
+
+    // forced neighbor checks look one cell to the side and one ahead, so
+    // a changed cell affects the straight entries of adjacent rows/cols
+    int r0 = std::max(cy0-1, 0), r1 = std::min(cy1+1, sizeY-1);
+    int c0 = std::max(cx0-1, 0), c1 = std::min(cx1+1, sizeX-1);
+
+    for(int y = r0; y <= r1; y++)
+        update_straight_row(y);
+
+    for(int x = c0; x <= c1; x++)
+        update_straight_col(x);
+
+    update_diagonals(std::max(r0-1, 0), std::min(r1+1, sizeY-1),
+                     std::max(c0-1, 0), std::min(c1+1, sizeX-1));
+}
+
+/**********************************************************************
+  JPS+ version of explore_straight. The jump point (or wall) ahead is
+  read from the tables, the only thing left to check is whether the
+  destination lies on the ray before it.
+
+  Inputs:
+    - start: JPSNode_t that was popped off the queue.
+
+  Returns:
+    - True if a jump point has been found and added to queue.
+    - False otherwise
+***********************************************************************/
+bool JPSPlan::explore_straight_plus(const JPSNode_t& start){
+
+    int dirx = start.dirx;
+    int diry = start.diry;
+    int ind = start.y*sizeX + start.x;
+
+    set_closed(ind);
+
+    int d = jumpDist[ind*8 + dir_index(dirx, diry)];
+    numScanned++;
+    int reach = d > 0 ? d : -d;
+
+    int k = -1;
+    if (dirx != 0 && destY == start.y)
+        k = (destX - start.x)*dirx;
+    else if (diry != 0 && destX == start.x)
+        k = (destY - start.y)*diry;
+
+    if (k >= 1 && k <= reach){
+        set_parent(destY*sizeX + destX, ind, start.cost + k);
+        add_to_queue(destX, destY, dirx, diry, start.cost + k);
+        return true;
+    }
+
+    if (d <= 0)
+        return false;
+
+    int x = start.x + d*dirx;
+    int y = start.y + d*diry;
+    double cost = start.cost + d;
+
+    if (dirx != 0){
+        if (cell_blocked(x, y+1) && !cell_blocked(x+dirx, y+1))
+            add_to_queue(x, y, dirx, 1, cost);
+
+        if (cell_blocked(x, y-1) && !cell_blocked(x+dirx, y-1))
+            add_to_queue(x, y, dirx, -1, cost);
+    }
+    else{
+        if (cell_blocked(x+1, y) && !cell_blocked(x+1, y+diry))
+            add_to_queue(x, y, 1, diry, cost);
+
+        if (cell_blocked(x-1, y) && !cell_blocked(x-1, y+diry))
+            add_to_queue(x, y, -1, diry, cost);
+    }
+
+    set_parent(y*sizeX + x, ind, cost);
+    add_to_queue(x, y, dirx, diry, cost);
+    return true;
+}
+
+/**********************************************************************
+  JPS+ version of explore_diagonal. Instead of stepping one cell at a
+  time, the diagonal is walked from jump point to jump point using the
+  tables. The walk also stops on the row and column of the destination
+  so the straight scans from there can find it.
+
+  Inputs:
+    - start: JPSNode_t that was popped off the queue.
+
+  Returns:
+    - True if the destination has been found on the diagonal.
+    - False otherwise
+***********************************************************************/
+bool JPSPlan::explore_diagonal_plus(const JPSNode_t& start){
+
+    int dirx = start.dirx;
+    int diry = start.diry;
+    int di = dir_index(dirx, diry);
+    int startInd = start.y*sizeX + start.x;
+
+    set_closed(startInd);
+
+    // number of diagonal steps until the destination's row / column
+    int kRow = (destY - start.y)*diry;
+    int kCol = (destX - start.x)*dirx;
+
+    int x = start.x;
+    int y = start.y;
+    int k = 0;
+    double cost = start.cost;
+
+    while (true){
+        int d = jumpDist[(y*sizeX + x)*8 + di];
+        int step = d > 0 ? d : -d;
+        numScanned++;
+        bool is_jump = d > 0;
+
+        if (kRow > k && kRow-k < step){
+            step = kRow-k;
+            is_jump = false;
+        }
+
+        if (kCol > k && kCol-k < step){
+            step = kCol-k;
+            is_jump = false;
+        }
+
+        bool on_goal_line = kRow == k+step || kCol == k+step;
+        if (step == 0 || (!is_jump && !on_goal_line))
+            return false;
+
+        int px = x + (step-1)*dirx;
+        int py = y + (step-1)*diry;
+        x += step*dirx;
+        y += step*diry;
+        k += step;
+        cost += step;
+
+        int ind = y*sizeX + x;
+        if (x == destX && y == destY){
+            set_parent(ind, startInd, cost);
+            add_to_queue(x, y, dirx, diry, cost);
+            return true;
+        }
+
+        if (cell_blocked(px, y) && !cell_blocked(px, y+diry)){
+            set_parent(ind, startInd, cost);
+            add_to_queue(x, y, -dirx, diry, cost);
+        }
+
+        if (cell_blocked(x, py) && !cell_blocked(x+dirx, py)){
+            set_parent(ind, startInd, cost);
+            add_to_queue(x, y, dirx, -diry, cost);
+        }
+
+        JPSNode_t horN;
+        horN.x = x;
+        horN.y = y;
+        horN.dirx = dirx;
+        horN.diry = 0;
+        horN.cost = cost;
+        bool found_hor = explore_straight_plus(horN);
+
+        JPSNode_t verN;
+        verN.x = x;
+        verN.y = y;
+        verN.dirx = 0;
+        verN.diry = diry;
+        verN.cost = cost;
+        bool found_ver = explore_straight_plus(verN);
+
+        if (found_ver || found_hor)
+            set_parent(ind, startInd, cost);
+    }
+}
@@ -0,0 +1,161 @@
+#include <math.h>
+#include <limits>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <robust_fast_navigation/JPS.h>
+
+/**********************************************************************
+  Any-angle search for JPSPlan (Lazy Theta*, Nash et al. 2010). Like A*
+  on the 8-connected grid, except that a cell may take the parent of
+  the cell it was reached from as its own parent, so the parents tree
+  is made of straight segments at any angle instead of grid moves. The
+  line of sight for that shortcut is only checked (with los_blocked) when
+  the cell is expanded, and if it is blocked the cell falls back to its
+  best expanded neighbor. Costs are euclidean distances in cells and
+  the heuristic is the straight line distance to the destination, so
+  the resulting paths are taut. Around the rounded inflated obstacles
+  they still bend at several close vertices, which the simplification
+  in getPath merges.
+
+  Shares the dense closed set and parents with the jump point search,
+  getPath reads the path the same way.
+***********************************************************************/
+
+/**********************************************************************
+  Straight line distance from a cell to the destination, in cells, or
+  the landmark bound if it is larger. Every segment of an any-angle
+  path is at least as long as the number of grid steps along it, so 
+  the landmark bound still underestimates the remaining cost.
+***********************************************************************/
+double JPSPlan::theta_heuristic(int ind) const{
+    double h = hypot(ind % sizeX - destX, ind / sizeX - destY);
+    if (landmarks)
+        h = std::max(h, landmarks->lower_bound(ind, destY*sizeX + destX));
+    return h;
+}
+
+/**********************************************************************
+  True if the grid move from cell a to its neighbor b is allowed: b is
+  free, and a diagonal move doesn't cut the corner of a blocked cell.
+***********************************************************************/
+bool JPSPlan::theta_can_move(int a, int b) const{
+    if (blocked(b))
+        return false;
+
+    int ax = a % sizeX, ay = a / sizeX;
+    int bx = b % sizeX, by = b / sizeX;
+    if (ax != bx && ay != by)
+        return !blocked(ay*sizeX + bx) && !blocked(by*sizeX + ax);
+
+    return true;
+}
+
+/**********************************************************************
+  Check the line of sight from a cell popped off the open list to the
+  parent it was given, and if it is blocked make the expanded neighbor
+  through which it is cheapest to reach its parent instead.
+***********************************************************************/
+void JPSPlan::theta_set_vertex(int ind){
+
+    int parent = parents[ind];
+    if (parent == ind)
+        return;
+
+    Eigen::Vector2d p(parent % sizeX, parent / sizeX);
+    Eigen::Vector2d c(ind % sizeX, ind / sizeX);
+    if (!los_blocked(p, c))
+        return;
+
+    int x = ind % sizeX;
+    int y = ind / sizeX;
+    thetaG[ind] = std::numeric_limits<double>::infinity();
+    for(int ny = std::max(y-1, 0); ny <= std::min(y+1, sizeY-1); ny++)
+        for(int nx = std::max(x-1, 0); nx <= std::min(x+1, sizeX-1); nx++){
+            int n = ny*sizeX + nx;
+            if (n == ind || !is_closed(n) || !theta_can_move(n, ind))
+                continue;
+
+            double g = thetaG[n] + hypot(nx - x, ny - y);
+            if (g < thetaG[ind]){
+                thetaG[ind] = g;
+                parents[ind] = n;
+            }
+        }
+}
+
+/**********************************************************************
+  Run Lazy Theta* from the start to the destination, setting goalInd
+  if the destination was reached.
+***********************************************************************/
+void JPSPlan::theta_search(){
+
+    int cells = sizeX*sizeY;
+    if ((int) thetaG.size() != cells)
+        thetaG.resize(cells);
+    thetaQ.clear();
+
+    int start = startY*sizeX + startX;
+    int dest = destY*sizeX + destX;
+
+    // the landmarks know if the destination can be reached at all
+    if (landmarks && landmarks->lower_bound(start, dest) == std::numeric_limits<double>::infinity())
+        return;
+
+    set_parent(start, start);
+    thetaG[start] = 0;
+    JPSThetaEntry e = {theta_heuristic(start), start};
+    thetaQ.push_back(e);
+    numPushes++;
+
+    while (!thetaQ.empty()){
+        std::pop_heap(thetaQ.begin(), thetaQ.end(), theta_greater);
+        e = thetaQ.back();
+        thetaQ.pop_back();
+
+        // skip cells already expanded and entries made stale by a
+        // cheaper push of the same cell
+        int ind = e.ind;
+        if (is_closed(ind) || e.f > thetaG[ind] + theta_heuristic(ind) + 1e-9){
+            numClosedHits++;
+            continue;
+        }
+
+        numExpansions++;
+        theta_set_vertex(ind);
+        set_closed(ind);
+
+        if (ind == dest){
+            goalInd = ind;
+            return;
+        }
+
+        // neighbors are given the parent of this cell, assuming it can
+        // see them
+        int parent = parents[ind];
+        int px = parent % sizeX;
+        int py = parent / sizeX;
+        int x = ind % sizeX;
+        int y = ind / sizeX;
+        for(int ny = std::max(y-1, 0); ny <= std::min(y+1, sizeY-1); ny++)
+            for(int nx = std::max(x-1, 0); nx <= std::min(x+1, sizeX-1); nx++){
+                int n = ny*sizeX + nx;
+                numScanned++;
+                if (n == ind || is_closed(n) || !theta_can_move(ind, n))
+                    continue;
+
+                double g = thetaG[parent] + hypot(nx - px, ny - py);
+                if (parentGen[n] != generation || g < thetaG[n] - 1e-9){
+                    parentGen[n] = generation;
+                    parents[n] = parent;
+                    thetaG[n] = g;
+
+                    JPSThetaEntry ne = {g + theta_heuristic(n), n};
+                    thetaQ.push_back(ne);
+                    std::push_heap(thetaQ.begin(), thetaQ.end(), theta_greater);
+                    numPushes++;
+                }
+            }
+    }
+}
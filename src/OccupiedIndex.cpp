@@ -0,0 +1,218 @@
+#include <algorithm>
+
+#include <robust_fast_navigation/OccupiedIndex.h>
+
+OccupiedIndex::OccupiedIndex(){
+    _map = nullptr;
+    sizeX = 0;
+    sizeY = 0;
+    originX = 0;
+    originY = 0;
+    resolution = 1;
+    occLow = 253;
+    occHigh = 254;
+    connectivity = 0;
+    decimation = 1;
+    blocksX = 0;
+}
+
+/**********************************************************************
+  Count cells with a cost in [low, high] as occupied. The index is
+  rebuilt if the range changed.
+***********************************************************************/
+void OccupiedIndex::set_occ_range(int low, int high){
+    if (low == occLow && high == occHigh)
+        return;
+
+    occLow = low;
+    occHigh = high;
+    if (_map)
+        build();
+}
+
+/**********************************************************************
+  Only index the boundary of the obstacles: occupied cells with a free
+  4-neighbor (connectivity 4) or a free 8-neighbor (connectivity 8,
+  which keeps a thicker boundary without diagonal gaps). Cells outside
+  the map don't count as free. 0 indexes every occupied cell.
+***********************************************************************/
+void OccupiedIndex::set_boundary(int connectivity){
+    connectivity = connectivity <= 0 ? 0 : (connectivity <= 4 ? 4 : 8);
+    if (connectivity == this->connectivity)
+        return;
+
+    this->connectivity = connectivity;
+    if (_map)
+        build();
+}
+
+/**********************************************************************
+  Keep a single point for every block of cells x cells cells, at one of
+  the indexed cells inside it. 1 keeps a point per indexed cell.
+***********************************************************************/
+void OccupiedIndex::set_decimation(int cells){
+    cells = std::max(cells, 1);
+    if (cells == decimation)
+        return;
+
+    decimation = cells;
+    if (_map)
+        build();
+}
+
+/**********************************************************************
+  Set the grid the index is kept for. The index is rebuilt if the map,
+  its size or its placement changed (e.g. a rolling window moved),
+  otherwise changes to its cells have to be reported through 
+  update_map.
+
+  Inputs:
+    - map, sizeX, sizeY: the grid, row major
+    - originX, originY, resolution: world coordinates of the corner of
+      cell (0,0) and side of a cell
+***********************************************************************/
+void OccupiedIndex::set_map(const unsigned char* map, int sizeX, int sizeY,
+                            double originX, double originY, double resolution){
+    bool changed = map != _map || sizeX != this->sizeX || sizeY != this->sizeY ||
+                   originX != this->originX || originY != this->originY ||
+                   resolution != this->resolution;
+
+    _map = map;
+    this->sizeX = sizeX;
+    this->sizeY = sizeY;
+    this->originX = originX;
+    this->originY = originY;
+    this->resolution = resolution;
+
+    if (changed)
+        build();
+}
+
+/**********************************************************************
+  Bring the cells inside [x0,xn) x [y0,yn) up to date, e.g. the cells
+  changed since the last call. When only the boundary is indexed, the
+  cells around the region are checked again too.
+
+  Inputs:
+    - x0, xn: first and one past last column of the region
+    - y0, yn: first and one past last row of the region
+***********************************************************************/
+void OccupiedIndex::update_map(int x0, int xn, int y0, int yn){
+
+    if (xn <= x0 || yn <= y0)
+        return;
+
+    int pad = connectivity > 0 ? 1 : 0;
+    refresh(std::max(x0-pad, 0), std::min(xn+pad, sizeX),
+            std::max(y0-pad, 0), std::min(yn+pad, sizeY));
+}
+
+/**********************************************************************
+  True if cell (x,y) belongs in the index (see set_boundary).
+***********************************************************************/
+bool OccupiedIndex::indexed(int x, int y) const{
+    if (!occupied(x, y))
+        return false;
+
+    if (connectivity == 0)
+        return true;
+
+    for(int dy = -1; dy <= 1; dy++)
+        for(int dx = -1; dx <= 1; dx++){
+            if ((dx == 0 && dy == 0) || (connectivity == 4 && dx != 0 && dy != 0))
+                continue;
+
+            int nx = x+dx, ny = y+dy;
+            if (nx >= 0 && ny >= 0 && nx < sizeX && ny < sizeY && !occupied(nx, ny))
+                return true;
+        }
+
+    return false;
+}
+
+/**********************************************************************
+  Add cell (x,y) to the index. Its block gets a point at the center of
+  the cell if it has none yet.
+***********************************************************************/
+void OccupiedIndex::add_cell(int x, int y){
+    int ind = y*sizeX + x;
+    int b = block_of(x, y);
+    member[ind] = 1;
+    if (count[b]++ > 0)
+        return;
+
+    slot[b] = pts.size();
+    repCell[b] = ind;
+    blocks.push_back(b);
+    pts.push_back(Eigen::Vector3d(originX + (x + .5)*resolution,
+                                  originY + (y + .5)*resolution, 0));
+}
+
+/**********************************************************************
+  Remove cell (x,y) from the index. The point of its block goes away
+  with the last cell of the block (the last point takes its place), or
+  moves to another indexed cell of the block if it was at this one.
+***********************************************************************/
+void OccupiedIndex::remove_cell(int x, int y){
+    int ind = y*sizeX + x;
+    int b = block_of(x, y);
+    member[ind] = 0;
+
+    if (--count[b] == 0){
+        int s = slot[b];
+        int last = blocks.back();
+        blocks[s] = last;
+        pts[s] = pts.back();
+        slot[last] = s;
+        slot[b] = -1;
+        repCell[b] = -1;
+        blocks.pop_back();
+        pts.pop_back();
+        return;
+    }
+
+    if (repCell[b] != ind)
+        return;
+
+    int bx = x - x % decimation;
+    int by = y - y % decimation;
+    for(int cy = by; cy < std::min(by + decimation, sizeY); cy++)
+        for(int cx = bx; cx < std::min(bx + decimation, sizeX); cx++)
+            if (member[cy*sizeX + cx]){
+                repCell[b] = cy*sizeX + cx;
+                pts[slot[b]] = Eigen::Vector3d(originX + (cx + .5)*resolution,
+                                               originY + (cy + .5)*resolution, 0);
+                return;
+            }
+}
+
+/**********************************************************************
+  Check every cell inside [x0,xn) x [y0,yn) against the index.
+***********************************************************************/
+void OccupiedIndex::refresh(int x0, int xn, int y0, int yn){
+    for(int y = y0; y < yn; y++)
+        for(int x = x0; x < xn; x++){
+            bool in = indexed(x, y);
+            if (in && !member[y*sizeX + x])
+                add_cell(x, y);
+            else if (!in && member[y*sizeX + x])
+                remove_cell(x, y);
+        }
+}
+
+/**********************************************************************
+  Index every cell of the map from scratch.
+***********************************************************************/
+void OccupiedIndex::build(){
+    blocksX = (sizeX + decimation - 1) / decimation;
+    int nb = blocksX * ((sizeY + decimation - 1) / decimation);
+
+    member.assign(sizeX*sizeY, 0);
+    count.assign(nb, 0);
+    repCell.assign(nb, -1);
+    slot.assign(nb, -1);
+    blocks.clear();
+    pts.clear();
+
+    refresh(0, sizeX, 0, sizeY);
+}
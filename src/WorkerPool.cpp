@@ -0,0 +1,90 @@
+#include <robust_fast_navigation/WorkerPool.h>
+
+WorkerPool::WorkerPool(){
+    job = nullptr;
+    arg = nullptr;
+    workers = 0;
+    round = 0;
+    busy = 0;
+    stop = false;
+}
+
+WorkerPool::~WorkerPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for(std::thread& t : threads)
+        t.join();
+}
+
+/**********************************************************************
+  Start threads until the pool can run workers workers (the calling
+  thread being one of them). Threads are never stopped before the pool
+  is destroyed.
+***********************************************************************/
+void WorkerPool::reserve(int workers){
+    std::lock_guard<std::mutex> lock(mutex);
+    while ((int) threads.size() < workers - 1)
+        threads.emplace_back(&WorkerPool::loop, this, (int) threads.size() + 1, round);
+}
+
+/**********************************************************************
+  Run job(arg, w) for w = 0..workers-1 in parallel, w = 0 on the
+  calling thread, and wait for all of them. The pool grows first if it
+  is too small.
+
+  Inputs:
+    - workers: number of workers, <= 1 runs job(arg, 0) only
+    - job, arg: the job and what it gets passed
+***********************************************************************/
+void WorkerPool::run(int workers, Job job, void* arg){
+    if (workers <= 1){
+        job(arg, 0);
+        return;
+    }
+
+    reserve(workers);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = job;
+        this->arg = arg;
+        this->workers = workers;
+        busy = workers - 1;
+        round++;
+    }
+    wake.notify_all();
+
+    job(arg, 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this](){ return busy == 0; });
+}
+
+/**********************************************************************
+  Body of pool thread worker: wait for a run after round seen, take
+  part in it if it asks for that many workers, repeat until the pool is
+  destroyed.
+***********************************************************************/
+void WorkerPool::loop(int worker, unsigned long seen){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true){
+        wake.wait(lock, [&](){ return stop || round != seen; });
+        if (stop)
+            return;
+
+        seen = round;
+        if (worker >= workers)
+            continue;
+
+        Job j = job;
+        void* a = arg;
+        lock.unlock();
+        j(a, worker);
+        lock.lock();
+
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
@@ -1,5 +1,7 @@
 #include <math.h>
 #include <cmath>
+#include <cstring>
+#include <chrono>
 #include <vector>
 #include <string>
 
@@ -35,9 +37,35 @@ Planner::Planner(ros::NodeHandle& nh){
     nh.param("robust_planner/const_factor", _const_factor, 6.);
     nh.param("robust_planner/simplify_jps", _simplify_jps, false);
     nh.param("robust_planner/failsafe_count", _failsafe_count, 2);
+    nh.param("robust_planner/failsafe_starts", _failsafe_starts, 0);
+    nh.param("robust_planner/failsafe_start_spacing", _failsafe_start_spacing, .5);
+    nh.param("robust_planner/failsafe_deadline", _failsafe_deadline, .05);
     nh.param("robust_planner/plan_in_free", _plan_in_free, false);
     nh.param("robust_planner/max_dist_horizon", _max_dist_horizon, 4.);
+    nh.param("robust_planner/reuse_jps_path", _reuse_jps_path, false);
+    nh.param("robust_planner/jps_reuse_tolerance", _jps_reuse_tolerance, .25);
+    nh.param("robust_planner/jps_reuse_cycles", _jps_reuse_cycles, 10);
     nh.param<std::string>("robust_planner/frame", _frame_str, "map");
+    nh.param<std::string>("robust_planner/jps_scan_mode", _jps_scan_mode, "cells");
+    nh.param<std::string>("robust_planner/jps_queue_mode", _jps_queue_mode, "heap");
+    nh.param<std::string>("robust_planner/jps_search_mode", _jps_search_mode, "forward");
+    nh.param<std::string>("robust_planner/jps_los_mode", _jps_los_mode, "bresenham");
+    nh.param("robust_planner/jps_los_margin", _jps_los_margin, 0);
+    nh.param("robust_planner/jps_epsilon", _jps_epsilon, 1.);
+    nh.param("robust_planner/jps_epsilon_step", _jps_epsilon_step, .5);
+    nh.param("robust_planner/jps_time_budget", _jps_time_budget, 0.);
+    nh.param("robust_planner/jps_max_expansions", _jps_max_expansions, 0);
+    nh.param("robust_planner/jps_cost_threshold", _jps_cost_threshold, 0);
+    nh.param("robust_planner/jps_unknown_blocked", _jps_unknown_blocked, true);
+    nh.param("robust_planner/jps_landmarks", _jps_landmarks, 0);
+    nh.param<std::string>("robust_planner/jps_landmark_file", _jps_landmark_file, "");
+    nh.param("robust_planner/hpa_cluster_size", _hpa_cluster_size, 0);
+    nh.param("robust_planner/corridor_boundary", _corridor_boundary, 0);
+    nh.param("robust_planner/corridor_decimation", _corridor_decimation, 1);
+    nh.param("robust_planner/corridor_threads", _corridor_threads, 1);
+    nh.param("robust_planner/corridor_planar", _corridor_planar, false);
+    nh.param("robust_planner/corridor_reuse", _corridor_reuse, false);
+    nh.param("robust_planner/horizon_candidates", _horizon_candidates, 0);
 
     // Publishers 
     trajVizPub = 
@@ -70,6 +98,11 @@ Planner::Planner(ros::NodeHandle& nh){
     jpsPointsPub = 
         nh.advertise<visualization_msgs::Marker>("/jpsPoints", 0);
 
+#ifdef JPS_TRACE
+    jpsTracePub = 
+        nh.advertise<visualization_msgs::Marker>("/jpsTrace", 0);
+#endif
+
     currPolyPub = 
         nh.advertise<geometry_msgs::PoseArray>("/currPoly", 0);
 
@@ -94,8 +127,63 @@ Planner::Planner(ros::NodeHandle& nh){
 
     _map_received = false;
     _is_costmap_started = false;
-
-    _prev_jps_cost = -1;
+    _landmarks_started = false;
+
+    _snapshot_size_x = 0;
+    _snapshot_origin_x = 0;
+    _snapshot_origin_y = 0;
+
+    _failsafe_x0 = _failsafe_xn = _failsafe_y0 = _failsafe_yn = 0;
+
+    _projection_valid = false;
+    _projected_x0 = _projected_xn = _projected_y0 = _projected_yn = 0;
+
+    _jps.set_occ_value(costmap_2d::INSCRIBED_INFLATED_OBSTACLE);
+    _jps.set_cost_threshold(_jps_cost_threshold, _jps_unknown_blocked);
+    _hpa.set_blocked_rule(_jps.get_blocked_rule());
+    _hpa.set_cluster_size(_hpa_cluster_size);
+    _occupied.set_boundary(_corridor_boundary);
+    _occupied.set_decimation(_corridor_decimation);
+
+    if (_jps_scan_mode == "jps_plus")
+        _jps.set_scan_mode(SCAN_JPS_PLUS);
+    else if (_jps_scan_mode == "block")
+        _jps.set_scan_mode(SCAN_BLOCK);
+    else if (_jps_scan_mode != "cells")
+        ROS_WARN("unknown jps_scan_mode %s, using cells", _jps_scan_mode.c_str());
+
+    if (_jps_queue_mode == "bucket")
+        _jps.set_queue_mode(QUEUE_BUCKET);
+    else if (_jps_queue_mode != "heap")
+        ROS_WARN("unknown jps_queue_mode %s, using heap", _jps_queue_mode.c_str());
+
+    if (_jps_search_mode == "incremental")
+        _jps.set_search_mode(SEARCH_INCREMENTAL);
+    else if (_jps_search_mode == "bidirectional")
+        _jps.set_search_mode(SEARCH_BIDIRECTIONAL);
+    else if (_jps_search_mode == "theta")
+        _jps.set_search_mode(SEARCH_THETA);
+    else if (_jps_search_mode != "forward")
+        ROS_WARN("unknown jps_search_mode %s, using forward", _jps_search_mode.c_str());
+
+    if (_jps_los_mode == "distance")
+        _jps.set_los_mode(LOS_DISTANCE);
+    else if (_jps_los_mode != "bresenham")
+        ROS_WARN("unknown jps_los_mode %s, using bresenham", _jps_los_mode.c_str());
+    _jps.set_los_margin(_jps_los_margin);
+    _jps.set_epsilon_schedule(_jps_epsilon, _jps_epsilon_step);
+    _jps.set_budget(_jps_time_budget, _jps_max_expansions);
+
+    // one planner per failsafe start, with the settings of _jps but plain
+    // forward searches cut off at the deadline
+    if (_failsafe_starts > 0){
+        _failsafe_jps.assign(_failsafe_starts + 2, _jps);
+        for(JPSPlan& jps : _failsafe_jps){
+            jps.set_search_mode(SEARCH_FORWARD);
+            jps.set_budget(_failsafe_deadline, 0);
+        }
+    }
+    _workers.reserve(std::max(_corridor_threads, (int) _failsafe_jps.size()));
 
     ROS_INFO("Initialized planner!");
 }
@@ -151,14 +239,137 @@ void Planner::clickedPointcb(const geometry_msgs::PointStamped::ConstPtr& msg){
 
 /**********************************************************************
   Function to project a point into the costmap for planning purposes.
+  If the goal is blocked or outside of the map, it is moved to the free
+  cells closest to it which can be reached from the start of _jps. The
+  free cells of the closest ring around the goal are all checked with
+  a single search; if none of them can be reached, that search has gone
+  through every reachable cell, and the closest ring with any of those
+  is taken instead. _jps must already have its map and start set.
+
+  The result is kept for the same goal until cells within the ring it
+  was found on change (see plan), or the path to it fails.
 
   Inputs:
-    - Goal coordinates
+    - Goal coordinates, replaced by the projected goal
 
-  TODOS: Implement :)
+  Returns:
+    - False if no reachable free cell was found around the goal
 ***********************************************************************/
-void Planner::projectIntoMap(const Eigen::Vector2d& goal){
-    
+bool Planner::projectIntoMap(Eigen::Vector2d& goal){
+
+    costmap_2d::Costmap2D* _map = global_costmap->getCostmap();
+    int sizeX = _map->getSizeInCellsX();
+    int sizeY = _map->getSizeInCellsY();
+
+    int gX, gY;
+    _map->worldToMapNoBounds(goal(0), goal(1), gX, gY);
+
+    if (gX >= 0 && gY >= 0 && gX < sizeX && gY < sizeY &&
+        !_jps.is_cell_blocked(gX, gY))
+        return true;
+
+    if (_projection_valid && goal == _projected_goal){
+        goal = _projected_to;
+        return true;
+    }
+    _projection_valid = false;
+
+    // rings up to the farthest corner of the map
+    int radius = std::max(std::max(std::abs(gX), std::abs(gX-sizeX+1)), 
+                          std::max(std::abs(gY), std::abs(gY-sizeY+1)));
+
+    std::vector<Eigen::Vector2i> cells;
+    int r = _jps.nearestFree(gX, gY, radius, cells);
+    if (r < 0)
+        return false;
+
+    std::vector<int> costs;
+    if (_jps.multiGoalSearch(cells, costs) == 0){
+        r = _jps.nearestReached(gX, gY, r+1, radius, cells);
+        if (r < 0 || _jps.multiGoalSearch(cells, costs) == 0)
+            return false;
+    }
+
+    // closest to the goal, shorter paths break ties
+    int best = -1;
+    double bestScore = 0;
+    for(int i = 0; i < cells.size(); i++){
+        if (costs[i] < 0)
+            continue;
+
+        double score = (cells[i] - Eigen::Vector2i(gX, gY)).cast<double>().norm() + 
+                       1e-3*costs[i];
+        if (best < 0 || score < bestScore){
+            best = i;
+            bestScore = score;
+        }
+    }
+
+    _projected_goal = goal;
+    _map->mapToWorld(cells[best][0], cells[best][1], goal(0), goal(1));
+    _projected_to = goal;
+    _projected_x0 = gX - r;
+    _projected_xn = gX + r + 1;
+    _projected_y0 = gY - r;
+    _projected_yn = gY + r + 1;
+    _projection_valid = true;
+    return true;
+}
+
+/**********************************************************************
+  Function to pick the intermediate goal on the planning horizon. Free
+  cells on the circle of radius _max_dist_horizon around the robot are
+  all checked with a single search from the start of _jps, and the one
+  with the lowest path cost plus straight line distance to the goal
+  is kept.
+
+  Inputs:
+    - goal: final goal, in world coordinates
+
+  Outputs:
+    - path: JPS path from the start to the chosen cell
+    - horizonGoal: the chosen cell, in world coordinates
+
+  Returns:
+    - False if none of the cells on the circle could be reached
+***********************************************************************/
+bool Planner::planToHorizon(const Eigen::Vector2d& goal, std::vector<Eigen::Vector2d>& path,
+                            Eigen::Vector2d& horizonGoal){
+
+    costmap_2d::Costmap2D* _map = global_costmap->getCostmap();
+    double res = _map->getResolution();
+
+    std::vector<Eigen::Vector2i> cells;
+    for(int i = 0; i < _horizon_candidates; i++){
+        double th = 2*M_PI*i/_horizon_candidates;
+        int cX, cY;
+        _map->worldToMapNoBounds(_odom(0) + _max_dist_horizon*cos(th), 
+                                 _odom(1) + _max_dist_horizon*sin(th), cX, cY);
+        cells.push_back(Eigen::Vector2i(cX, cY));
+    }
+
+    std::vector<int> costs;
+    if (_jps.multiGoalSearch(cells, costs) == 0)
+        return false;
+
+    int best = -1;
+    double bestScore = 0;
+    for(int i = 0; i < cells.size(); i++){
+        if (costs[i] < 0)
+            continue;
+
+        double wx, wy;
+        _map->mapToWorld(cells[i][0], cells[i][1], wx, wy);
+        double score = costs[i]*res + (Eigen::Vector2d(wx, wy) - goal).norm();
+        if (best < 0 || score < bestScore){
+            best = i;
+            bestScore = score;
+            horizonGoal = Eigen::Vector2d(wx, wy);
+        }
+    }
+
+    path = _jps.getPathTo(cells[best][0], cells[best][1], _simplify_jps);
+    return path.size() > 0;
 }
 
 /**********************************************************************
@@ -179,7 +390,9 @@ void Planner::goalcb(const geometry_msgs::PoseStamped::ConstPtr& msg){
 }
 
 /**********************************************************************
-  Function which publishes the occupied cells of a global costmap.
+  Function which publishes the occupied cells of a global costmap the
+  corridor is built around (only their boundary with corridor_boundary
+  set).
 ***********************************************************************/
 void Planner::publishOccupied(const ros::TimerEvent&){
 
@@ -187,7 +400,6 @@ void Planner::publishOccupied(const ros::TimerEvent&){
         return;
 
     costmap_2d::Costmap2D* _map = global_costmap->getCostmap();
-    vec_Vec2f padded = corridor::getOccupied(*_map);
     visualization_msgs::Marker paddedMsg;
     paddedMsg.header.frame_id = _frame_str;
     paddedMsg.header.stamp = ros::Time::now();
@@ -204,7 +416,7 @@ void Planner::publishOccupied(const ros::TimerEvent&){
     paddedMsg.color.b = 0.216;
     paddedMsg.color.a = .55;
 
-    for(Eigen::Vector2d p : padded){
+    for(const Eigen::Vector3d& p : _occupied.points()){
         geometry_msgs::Point pMs;
         pMs.x = p[0];
         pMs.y = p[1];
@@ -228,6 +440,288 @@ void Planner::publishOccupied(const ros::TimerEvent&){
 void Planner::mapcb(const nav_msgs::OccupancyGrid::ConstPtr& msg){
     map = *msg;
     _map_received = true;
+
+    // new static map, landmarks have to be built again
+    _landmarks_started = false;
+}
+
+/**********************************************************************
+  Failsafe search from several starts at once: the robot itself, the
+  lookahead point on sentTraj and _failsafe_starts points further along
+  it, _failsafe_start_spacing seconds apart. Every start gets its own
+  planner from _failsafe_jps and a worker of _workers. The planners
+  work on the snapshot of the costmap taken under its lock this cycle
+  (see getChangedBounds) and only catch up on the cells changed since
+  they last ran. _failsafe_deadline counts from the call, map sync
+  included, and cuts the searches off. Of the complete paths, the one
+  with the lowest length along sentTraj up to its start plus JPS path 
+  length is kept. Starts whose stretch of sentTraj crosses a blocked
+  cell are skipped, since the robot would have to drive it first.
+
+  Inputs:
+    - lookInd: index of the lookahead point on sentTraj
+    - eX, eY: destination cell
+
+  Outputs:
+    - path: JPS path from the chosen start to the destination
+    - startPos: the chosen start (position of the sentTraj point)
+    - stitchInd: index of the chosen start on sentTraj, 0 for the 
+      robot itself, i.e. how much of sentTraj to keep before the new
+      trajectory
+
+  Returns:
+    - False if no start led to the destination
+***********************************************************************/
+bool Planner::failsafeSearch(int lookInd, unsigned int eX, unsigned int eY,
+                             std::vector<Eigen::Vector2d>& path,
+                             Eigen::Vector3d& startPos, int& stitchInd){
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point deadline = Clock::now() + 
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(_failsafe_deadline));
+
+    // the snapshot may be smaller than the costmap by now
+    costmap_2d::Costmap2D* _map = global_costmap->getCostmap();
+    int sizeX = _snapshot_size_x;
+    int sizeY = sizeX > 0 ? _map_snapshot.size() / sizeX : 0;
+    double originX = _snapshot_origin_x;
+    double originY = _snapshot_origin_y;
+    double res = _map->getResolution();
+
+    // where the robot is on sentTraj right now
+    int n = sentTraj.points.size();
+    int curInd = std::min((int) ((ros::Time::now()-start).toSec()/_traj_dt), n-1);
+    int step = std::max((int) std::round(_failsafe_start_spacing/_traj_dt), 1);
+
+    std::vector<Eigen::Vector3d> starts;
+    std::vector<int> inds;
+    std::vector<double> prefix;
+    starts.push_back(Eigen::Vector3d(_odom(0), _odom(1), 0));
+    inds.push_back(0);
+    prefix.push_back(0);
+
+    double driven = 0;
+    int last = curInd;
+    for(int k = 0; k <= _failsafe_starts; k++){
+        int ind = std::min(lookInd + k*step, n-1);
+        if (ind <= last && k > 0)
+            break;
+
+        bool clear = true;
+        for(int i = last+1; i <= ind && clear; i++){
+            const std::vector<double>& q = sentTraj.points[i].positions;
+            const std::vector<double>& pq = sentTraj.points[i-1].positions;
+            unsigned int mx, my;
+            clear = _map->worldToMap(q[0], q[1], mx, my) && !_jps.is_cell_blocked(mx, my);
+            driven += std::hypot(q[0]-pq[0], q[1]-pq[1]);
+        }
+
+        // everything further along has to drive through the same cell
+        if (!clear)
+            break;
+
+        const std::vector<double>& q = sentTraj.points[ind].positions;
+        starts.push_back(Eigen::Vector3d(q[0], q[1], q[2]));
+        inds.push_back(ind);
+        prefix.push_back(driven);
+        last = ind;
+    }
+
+    // start cells in the snapshot, -1 outside of it
+    std::vector<int> startCells(starts.size(), -1);
+    for(int i = 0; i < starts.size(); i++){
+        int sX = (int) std::floor((starts[i][0] - originX) / res);
+        int sY = (int) std::floor((starts[i][1] - originY) / res);
+        if (sX >= 0 && sY >= 0 && sX < sizeX && sY < sizeY)
+            startCells[i] = sY*sizeX + sX;
+    }
+
+    // every planner catches up, also those without a start this time, so
+    // the changed region can be reset for all of them afterwards
+    std::vector<std::vector<Eigen::Vector2d> > paths(starts.size());
+    std::shared_ptr<const JPSLandmarks> lm = _landmark_fields;
+    auto search = [&](int i){
+        JPSPlan& jps = _failsafe_jps[i];
+        jps.set_map(_map_snapshot.data(), sizeX, sizeY, originX, originY, res);
+        if (_failsafe_xn > _failsafe_x0)
+            jps.update_map(_failsafe_x0, _failsafe_xn, _failsafe_y0, _failsafe_yn);
+        if (lm)
+            jps.set_landmarks(lm);
+
+        if (i >= starts.size() || startCells[i] < 0)
+            return;
+
+        // the budget is what is left of the deadline, none is unlimited
+        double left = std::chrono::duration<double>(deadline - Clock::now()).count();
+        if (left <= 0)
+            return;
+
+        jps.set_budget(left, 0);
+        jps.set_start(startCells[i] % sizeX, startCells[i] / sizeX);
+        jps.set_destination(eX, eY);
+        jps.JPS();
+        if (!jps.is_partial())
+            paths[i] = jps.getPath(_simplify_jps);
+    };
+    _workers.run(_failsafe_jps.size(), search);
+    _failsafe_x0 = _failsafe_xn = _failsafe_y0 = _failsafe_yn = 0;
+
+    int best = -1;
+    double bestCost = 0;
+    for(int i = 0; i < paths.size(); i++){
+        const std::vector<Eigen::Vector2d>& p = paths[i];
+        if (p.empty())
+            continue;
+
+        double cost = prefix[i];
+        for(int j = 1; j < p.size(); j++)
+            cost += (p[j] - p[j-1]).norm();
+
+        if (best < 0 || cost < bestCost){
+            best = i;
+            bestCost = cost;
+        }
+    }
+
+    if (best < 0)
+        return false;
+
+    ROS_INFO("failsafe: planning from start %d of %lu (cost %.2f m)", best, starts.size(), bestCost);
+    path.swap(paths[best]);
+    startPos = starts[best];
+    stitchInd = inds[best];
+    return true;
+}
+
+/**********************************************************************
+  Find the cells of the global costmap that changed since the last 
+  call, by comparing it with a copy kept from then. The bounds of the
+  layered costmap only cover its most recent update, every update 
+  between two planning cycles but the last would be missed with them.
+
+  Inputs:
+    - map: global costmap
+
+  The comparison runs under the costmap lock, so the copy is a 
+  consistent snapshot of the map, which the failsafe searches read
+  instead of the live costmap (see failsafeSearch).
+
+  Outputs:
+    - x0, xn, y0, yn: bounding box [x0,xn) x [y0,yn) of the changed
+      cells, empty if none changed. The whole map on the first call and
+      when the map was resized or moved.
+***********************************************************************/
+void Planner::getChangedBounds(costmap_2d::Costmap2D* map, int& x0, int& xn, int& y0, int& yn){
+
+    boost::unique_lock<costmap_2d::Costmap2D::mutex_t> lock(*map->getMutex());
+
+    const unsigned char* grid = map->getCharMap();
+    int sizeX = map->getSizeInCellsX();
+    int sizeY = map->getSizeInCellsY();
+    size_t cells = (size_t) sizeX*sizeY;
+
+    if (_map_snapshot.size() != cells || _snapshot_size_x != sizeX ||
+        _snapshot_origin_x != map->getOriginX() || _snapshot_origin_y != map->getOriginY()){
+
+        _map_snapshot.assign(grid, grid + cells);
+        _snapshot_size_x = sizeX;
+        _snapshot_origin_x = map->getOriginX();
+        _snapshot_origin_y = map->getOriginY();
+
+        x0 = 0;
+        xn = sizeX;
+        y0 = 0;
+        yn = sizeY;
+        return;
+    }
+
+    x0 = sizeX;
+    xn = 0;
+    y0 = sizeY;
+    yn = 0;
+    for(int y = 0; y < sizeY; y++){
+        const unsigned char* cur = grid + (size_t) y*sizeX;
+        unsigned char* old = &_map_snapshot[(size_t) y*sizeX];
+        if (memcmp(cur, old, sizeX) == 0)
+            continue;
+
+        int a = 0, b = sizeX;
+        while (a < b && cur[a] == old[a])
+            a++;
+        while (b > a && cur[b-1] == old[b-1])
+            b--;
+
+        memcpy(old + a, cur + a, b - a);
+
+        x0 = std::min(x0, a);
+        xn = std::max(xn, b);
+        y0 = std::min(y0, y);
+        yn = y + 1;
+    }
+
+    if (xn <= x0)
+        x0 = xn = y0 = yn = 0;
+}
+
+/**********************************************************************
+  Build the landmark fields of the JPS heuristic (see JPSLandmarks.h) 
+  for the static map in the background, and hand them over to _jps 
+  once they are ready. If jps_landmark_file is set, the fields are 
+  loaded from there when they match the map, otherwise they are 
+  computed and saved there for the next run. A jps_landmark_file 
+  ending in / is a directory, the file in it is named after the map
+  (see JPSLandmarks::file_name).
+
+  Inputs:
+    - map: global costmap, whose cells are copied when the build starts
+***********************************************************************/
+void Planner::updateLandmarks(costmap_2d::Costmap2D* map){
+
+    // fields of another blocked rule than _jps uses are computed again
+    if (_landmark_fields && !_landmark_fields->same_rule(_jps.get_blocked_rule())){
+        _landmark_fields.reset();
+        _landmarks_started = false;
+    }
+
+    if (!_landmarks_started){
+        _landmarks_started = true;
+
+        int sizeX = map->getSizeInCellsX();
+        int sizeY = map->getSizeInCellsY();
+        std::vector<unsigned char> grid(map->getCharMap(), map->getCharMap() + sizeX*sizeY);
+        std::vector<uint8_t> rule(_jps.get_blocked_rule(), _jps.get_blocked_rule() + 256);
+        int num_landmarks = _jps_landmarks;
+        std::string file = _jps_landmark_file;
+
+        _landmark_future = std::async(std::launch::async, 
+            [grid, rule, sizeX, sizeY, num_landmarks, file]() -> std::shared_ptr<const JPSLandmarks>{
+                std::shared_ptr<JPSLandmarks> lm(new JPSLandmarks());
+
+                std::string path = file;
+                if (!path.empty() && path[path.size()-1] == '/')
+                    path += JPSLandmarks::file_name(grid.data(), sizeX, sizeY, rule.data());
+
+                if (!path.empty() && lm->load(path, grid.data(), sizeX, sizeY, rule.data())){
+                    ROS_INFO("loaded JPS landmarks from %s", path.c_str());
+                } else{
+                    lm->compute(grid.data(), sizeX, sizeY, rule.data(), num_landmarks);
+                    if (lm->num_landmarks() == 0)
+                        ROS_WARN("no JPS landmarks could be built for this map");
+                    else if (!path.empty() && !lm->save(path))
+                        ROS_WARN("could not save JPS landmarks to %s", path.c_str());
+                }
+
+                return std::shared_ptr<const JPSLandmarks>(lm);
+            });
+        return;
+    }
+
+    if (_landmark_future.valid() && 
+        _landmark_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready){
+        _landmark_fields = _landmark_future.get();
+        _jps.set_landmarks(_landmark_fields);
+        ROS_INFO("using JPS landmarks");
+    }
 }
 
 /**********************************************************************
@@ -513,6 +1007,9 @@ bool Planner::plan(bool is_failsafe){
         ROS_INFO("*******************************");
         ROS_INFO("*** FAILSAFE MODE  ENGAGED ****");
         ROS_INFO("*******************************");
+
+        // don't stick to a path the last cycles failed with
+        _jps.clearPathCache();
     }
 
     costmap_2d::Costmap2D* _map = global_costmap->getCostmap();
@@ -522,6 +1019,11 @@ bool Planner::plan(bool is_failsafe){
     Eigen::Matrix3d initialPVA;
     bool not_first = false;
 
+    // index of the start on sentTraj, and how much of sentTraj to keep
+    // if a failsafe search picked a different start (see failsafeSearch)
+    int lookInd = -1;
+    int stitchInd = -1;
+
     Eigen::Matrix3d finalPVA;
     finalPVA << Eigen::Vector3d(goal(0),goal(1),0), 
                 Eigen::Vector3d::Zero(), 
@@ -540,6 +1042,7 @@ bool Planner::plan(bool is_failsafe){
         double tmpT = t;
         
         int trajInd = std::min((int) (t/_traj_dt), (int) sentTraj.points.size()-1);
+        lookInd = trajInd;
 
         trajectory_msgs::JointTrajectoryPoint p = sentTraj.points[trajInd];
 
@@ -572,62 +1075,127 @@ bool Planner::plan(bool is_failsafe){
     ************ PERFORM  JPS ************
     **************************************/
 
-    JPSPlan jps;
     unsigned int sX, sY, eX, eY;
     _map->worldToMap(initialPVA.col(0)[0], initialPVA.col(0)[1], sX, sY);
-    _map->worldToMap(goal(0), goal(1), eX, eY);
 
-    jps.set_start(sX, sY);
-    jps.set_destination(eX, eY);
-    jps.set_occ_value(costmap_2d::INSCRIBED_INFLATED_OBSTACLE);
+    _jps.set_start(sX, sY);
 
-    jps.set_map(_map->getCharMap(), _map->getSizeInCellsX(), _map->getSizeInCellsY(),
+    // _jps only reallocates its buffers if the costmap was resized
+    _jps.set_map(_map->getCharMap(), _map->getSizeInCellsX(), _map->getSizeInCellsY(),
                 _map->getOriginX(), _map->getOriginY(), _map->getResolution());
-    jps.JPS();
 
-    std::vector<Eigen::Vector2d> jpsPath = jps.getPath(_simplify_jps);
-
-    if (jpsPath.size() == 0){
-        ROS_ERROR("JPS failed to find path");
-        return false;
+    // cells changed by all costmap updates since the last cycle
+    int cx0, cxn, cy0, cyn;
+    getChangedBounds(_map, cx0, cxn, cy0, cyn);
+
+    // a projected goal is kept while nothing changes around the goal
+    if (cxn > cx0 && cx0 < _projected_xn && _projected_x0 < cxn && cy0 < _projected_yn && _projected_y0 < cyn)
+        _projection_valid = false;
+
+    // the failsafe planners only catch up when they run
+    if (cxn > cx0 && _failsafe_xn > _failsafe_x0){
+        _failsafe_x0 = std::min(_failsafe_x0, cx0);
+        _failsafe_xn = std::max(_failsafe_xn, cxn);
+        _failsafe_y0 = std::min(_failsafe_y0, cy0);
+        _failsafe_yn = std::max(_failsafe_yn, cyn);
+    } else if (cxn > cx0){
+        _failsafe_x0 = cx0;
+        _failsafe_xn = cxn;
+        _failsafe_y0 = cy0;
+        _failsafe_yn = cyn;
     }
 
-    // double cost = 0;
-    // for(int i = 0; i < jpsPath.size(); i++){
-    //     double x, y;
-    //     _map->mapToWorld(jpsPath[i](0), jpsPath[i](1), x, y);
-    //     jpsPath[i] = Eigen::Vector2d(x,y);
+    // occupied cells the corridor is built around
+    _occupied.set_map(_map->getCharMap(), _map->getSizeInCellsX(), _map->getSizeInCellsY(),
+                      _map->getOriginX(), _map->getOriginY(), _map->getResolution());
+    _occupied.update_map(cx0, cxn, cy0, cyn);
 
-    //     if (i > 0)
-    //         cost += (jpsPath[i]-jpsPath[i-1]).norm();
-    // }
+    if (_jps_landmarks > 0)
+        updateLandmarks(_map);
 
-    // bool _is_old_jps_valid = true;
+    // refresh the blocked cells before anything searches, and let JPS+ /
+    // block scans patch their tables and the incremental search repair 
+    // its tree for the same cells
+    _jps.update_map(cx0, cxn, cy0, cyn);
 
-    // if (_prev_jps_path.size() > 0){
-    //     for(int i = 0; i < _prev_jps_path.size(); i++)
+    // plan to the closest reachable free cell if the goal is blocked
+    Eigen::Vector2d planGoal(goal(0), goal(1));
+    if (!projectIntoMap(planGoal)){
+        ROS_ERROR("no reachable free cell around the goal");
+        return false;
+    }
 
-    //     for(int i = 0; i < _prev_jps_path.size()-1; i++){
-    //         if (jps.isBlocked(_prev_jps_path[i], _prev_jps_path[i+1], false)){
-    //             _is_old_jps_valid = false;
-    //             break;
-    //         } else{
-    //             std::cout << _prev_jps_path[i].transpose()  << " to " << 
-    //                 _prev_jps_path[i+1].transpose() << " is not blocked" << std::endl;
-    //         }
-    //     }
-    // }
+    finalPVA.col(0) = Eigen::Vector3d(planGoal(0), planGoal(1), 0);
+    _map->worldToMap(planGoal(0), planGoal(1), eX, eY);
 
-    // if (_prev_jps_path.size() > 0 && fabs(_prev_jps_cost/cost - 1) < .01 &&
-    //     _is_old_jps_valid){
-    //     ROS_INFO("sticking with old JPS as new one wasn't significantly different");
-    //     jpsPath = _prev_jps_path;
-    // }
-    // else{
-    //     _prev_jps_path = jpsPath;
-    //     _prev_jps_cost = cost;
-    // }
+    // with horizon candidates, pick the intermediate goal on the horizon
+    // from a single search instead of clipping a path to the goal
+    std::vector<Eigen::Vector2d> jpsPath;
+    Eigen::Vector2d goalPoint;
+    bool onHorizon = _horizon_candidates > 0 && !_plan_in_free &&
+                     (planGoal - _odom.head(2)).norm() > _max_dist_horizon &&
+                     planToHorizon(planGoal, jpsPath, goalPoint);
+
+    if (!onHorizon){
+
+        // on large maps, get a coarse route from the abstract graph and only
+        // run JPS up to its first waypoint past the horizon
+        if (_hpa_cluster_size > 0){
+            int sizeX = _map->getSizeInCellsX();
+            _hpa.set_map(_map->getCharMap(), sizeX, _map->getSizeInCellsY());
+            _hpa.update_map(cx0, cxn, cy0, cyn);
+
+            std::vector<int> route;
+            if (_hpa.plan(sY*sizeX + sX, eY*sizeX + eX, route)){
+                for(int i = 1; i < route.size(); i++){
+                    double wx, wy;
+                    _map->mapToWorld(route[i] % sizeX, route[i] / sizeX, wx, wy);
+                    if ((Eigen::Vector2d(wx, wy) - _odom.head(2)).norm() > _max_dist_horizon){
+                        eX = route[i] % sizeX;
+                        eY = route[i] / sizeX;
+                        break;
+                    }
+                }
+            } else
+                ROS_WARN("no route in the abstract graph, running JPS on the full map");
+        }
 
+        _jps.set_destination(eX, eY);
+
+        // keep last cycle's path while it is clear and the robot follows
+        // it, only the segments over changed cells are checked again
+        if (_reuse_jps_path && 
+            _jps.reusePath(jpsPath, _jps_reuse_tolerance/_map->getResolution(), _jps_reuse_cycles)){
+            ROS_DEBUG("reusing previous JPS path");
+        } else if (is_failsafe && lookInd >= 0 && !_failsafe_jps.empty()){
+            Eigen::Vector3d startPos;
+            if (failsafeSearch(lookInd, eX, eY, jpsPath, startPos, stitchInd))
+                initialPVA.col(0) = startPos;
+        } else{
+            _jps.JPS();
+            JPSStats stats = _jps.get_stats();
+            ROS_DEBUG("JPS: %.2f ms, %d pushes, %d pops, %d cells scanned, %d closed hits, epsilon %.2f",
+                      stats.time*1e3, stats.pushes, stats.pops, stats.cellsScanned, 
+                      stats.closedHits, _jps.get_epsilon());
+#ifdef JPS_TRACE
+            pubJPSTrace();
+#endif
+
+            // a partial path still heads toward the goal, but must not be
+            // reused as if it reached it
+            jpsPath = _jps.getPath(_simplify_jps);
+            if (_jps.is_partial())
+                ROS_WARN("JPS ran out of budget, following a partial path");
+            else if (_reuse_jps_path)
+                _jps.cachePath(jpsPath);
+        }
+    }
+
+    if (jpsPath.size() == 0){
+        ROS_ERROR("JPS failed to find path");
+        _projection_valid = false;
+        return false;
+    }
 
     /*************************************
     ******** PUBLISH JPS TO RVIZ *********
@@ -650,8 +1218,11 @@ bool Planner::plan(bool is_failsafe){
 
     jpsPub.publish(jpsMsg);
 
-    Eigen::Vector2d goalPoint;
-    if (_plan_in_free){
+    if (onHorizon){
+        finalPVA << Eigen::Vector3d(goalPoint[0], goalPoint[1],0), 
+                Eigen::Vector3d::Zero(), 
+                Eigen::Vector3d::Zero();
+    } else if (_plan_in_free){
 
         nav_msgs::Path jpsMsgFree;
         jpsMsgFree.header.stamp = ros::Time::now();
@@ -707,7 +1278,10 @@ bool Planner::plan(bool is_failsafe){
 
     ROS_INFO("creating corridor");
     // don't neet to clear hPolys before calling because method will do it
-    if (!corridor::createCorridorJPS(jpsPath, *_map, _obs, hPolys)){
+    if (!corridor::createCorridorJPS(jpsPath, *_map, _occupied.points(), hPolys, 
+                                     _corridor_threads, _corridor_planar,
+                                     _corridor_reuse ? &_corridor_cache : nullptr,
+                                     &_corridor_workspace, &_workers)){
         ROS_ERROR("CORRIDOR GENERATION FAILED");
         return false;
     }
@@ -722,7 +1296,8 @@ bool Planner::plan(bool is_failsafe){
 
     corridor::visualizePolytope(hPolys, meshPub, edgePub);
 
-    ROS_INFO("generated corridor of size %lu", hPolys.size());
+    ROS_INFO("generated corridor of size %lu (%d polytopes reused)", hPolys.size(),
+             _corridor_reuse ? _corridor_cache.reused() : 0);
 
     /*************************************
     ******** GENERATE  TRAJECTORY ********
@@ -800,6 +1375,8 @@ bool Planner::plan(bool is_failsafe){
 
         int startInd = std::min((int)(t1/_traj_dt), (int) sentTraj.points.size()-1)+1;
         int trajInd = std::min((int) (t2/_traj_dt), (int) sentTraj.points.size()-1);
+        if (stitchInd >= 0)
+            trajInd = std::max(std::min(stitchInd, (int) sentTraj.points.size()-1), startInd);
 
         // ROS_INFO("[%.2f] startInd is %d\ttrajInd is %d", (ros::Time::now()-start).toSec(),startInd, trajInd);
 
@@ -984,3 +1561,40 @@ void Planner::pubPolys(){
     currPolyPub.publish(msg);
 
 }
+
+#ifdef JPS_TRACE
+/**********************************************************************
+  Publish the cells expanded by the last JPS search, in the order they
+  were expanded, for offline analysis of the search (e.g. recorded in
+  a bag). Only built with the JPS_TRACE option.
+***********************************************************************/
+void Planner::pubJPSTrace(){
+
+    costmap_2d::Costmap2D* _map = global_costmap->getCostmap();
+
+    visualization_msgs::Marker traceMsg;
+    traceMsg.header.frame_id = _frame_str;
+    traceMsg.header.stamp = ros::Time::now();
+    traceMsg.ns = "jps_trace";
+    traceMsg.id = 421;
+    traceMsg.type = visualization_msgs::Marker::POINTS;
+    traceMsg.action = visualization_msgs::Marker::ADD;
+    traceMsg.scale.x = _map->getResolution();
+    traceMsg.scale.y = traceMsg.scale.x;
+    traceMsg.pose.orientation.w = 1;
+    traceMsg.color.r = 0.1;
+    traceMsg.color.g = 0.6;
+    traceMsg.color.b = 0.9;
+    traceMsg.color.a = .8;
+
+    for(Eigen::Vector2d p : _jps.getTrace()){
+        geometry_msgs::Point pMs;
+        pMs.x = p[0];
+        pMs.y = p[1];
+        pMs.z = 0;
+        traceMsg.points.push_back(pMs);
+    }
+
+    jpsTracePub.publish(traceMsg);
+}
+#endif
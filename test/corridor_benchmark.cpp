@@ -0,0 +1,82 @@
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include <robust_fast_navigation/corridor.h>
+#include <robust_fast_navigation/WorkerPool.h>
+
+/**********************************************************************
+  Time of convexCover for 1, 2, 4 and 8 threads, with the workspace and
+  the worker pool of the planner, over a random 100m x 100m obstacle
+  field and a winding path through it. The first calls warm up the
+  workspace and the pool; the median of the timed calls is printed,
+  for the 3D and planar versions.
+
+  Usage: corridor_benchmark [calls]
+***********************************************************************/
+
+typedef std::chrono::steady_clock Clock;
+
+static void obstacleField(std::vector<Eigen::Vector3d>& points,
+                          std::vector<Eigen::Vector3d>& path){
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<double> u(0.0, 100.0);
+
+    for(int i = 0; i <= 24; i++)
+        path.push_back(Eigen::Vector3d(2.0 + 4.0*i, 50.0 + 25.0*std::sin(0.35*i), 0.0));
+
+    while (points.size() < 20000){
+        Eigen::Vector3d p(u(gen), u(gen), 0.0);
+
+        double clearance = INFINITY;
+        for(size_t i = 1; i < path.size(); i++){
+            Eigen::Vector3d d = path[i] - path[i-1];
+            double t = std::min(std::max((p - path[i-1]).dot(d) / d.squaredNorm(), 0.0), 1.0);
+            clearance = std::min(clearance, (path[i-1] + t*d - p).norm());
+        }
+        if (clearance > 0.5)
+            points.push_back(p);
+    }
+}
+
+int main(int argc, char** argv){
+    int calls = argc > 1 ? std::max(atoi(argv[1]), 1) : 20;
+
+    std::vector<Eigen::Vector3d> points, path;
+    obstacleField(points, path);
+
+    printf("%u hardware threads, %lu points, %d calls\n",
+           std::thread::hardware_concurrency(), points.size(), calls);
+    printf("threads   3D [ms]   planar [ms]   polytopes\n");
+
+    WorkerPool pool;
+    const int threadCounts[] = {1, 2, 4, 8};
+    for(int threads : threadCounts){
+        double median[2];
+        size_t polytopes = 0;
+        for(int planar = 0; planar < 2; planar++){
+            corridor::CorridorWorkspace cw;
+            std::vector<Eigen::MatrixX4d> hpolys;
+            std::vector<double> ms;
+
+            for(int call = -2; call < calls; call++){
+                Clock::time_point start = Clock::now();
+                corridor::convexCover(path, points, Eigen::Vector3d(0, 0, -.1),
+                                      Eigen::Vector3d(100, 100, .1), 7.0, 5.0, hpolys,
+                                      1.0e-6, threads, planar, nullptr, &cw, &pool);
+                if (call >= 0)
+                    ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            }
+
+            std::sort(ms.begin(), ms.end());
+            median[planar] = ms[ms.size()/2];
+            polytopes = hpolys.size();
+        }
+        printf("%7d   %7.2f   %11.2f   %9lu\n", threads, median[0], median[1], polytopes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+#include <gtest/gtest.h>
+#include <gcopter/firi.hpp>
+#include <robust_fast_navigation/corridor.h>
+
+// Every heap allocation goes through malloc (operator new and Eigen's
+// aligned_malloc alike), every thread counts its own, and all threads 
+// together count in allMallocs. glibc only.
+extern "C" void* __libc_malloc(size_t size);
+
+static thread_local long mallocs = 0;
+static thread_local bool counting = false;
+static std::atomic<long> allMallocs(0);
+static std::atomic<bool> countingAll(false);
+
+extern "C" void* malloc(size_t size){
+    if (counting)
+        mallocs++;
+    if (countingAll)
+        allMallocs++;
+    return __libc_malloc(size);
+}
+
+// polytopes of random halfspaces around the origin, of growing size
+static void randomPolytopes(std::vector<Eigen::MatrixX4d>& polys3,
+                            std::vector<Eigen::MatrixX3d>& polys2){
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> u(-1.0, 1.0);
+
+    for(int k = 0; k < 40; k++){
+        int M = 6 + k % 30;
+        Eigen::MatrixX4d h3(M, 4);
+        Eigen::MatrixX3d h2(M, 3);
+        for(int i = 0; i < M; i++){
+            Eigen::Vector3d n3(u(gen), u(gen), u(gen));
+            Eigen::Vector2d n2(u(gen), u(gen));
+            h3.row(i) << n3.normalized().transpose(), -(1.5 + 0.5*u(gen));
+            h2.row(i) << n2.normalized().transpose(), -(1.5 + 0.5*u(gen));
+        }
+        polys3.push_back(h3);
+        polys2.push_back(h2);
+    }
+}
+
+// solve all polytopes in ws, returns the number of heap allocations
+static long solveAll(const std::vector<Eigen::MatrixX4d>& polys3,
+                     const std::vector<Eigen::MatrixX3d>& polys2,
+                     firi::MVIEWorkspace& ws){
+    mallocs = 0;
+    counting = true;
+    for(size_t k = 0; k < polys3.size(); k++){
+        Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+        Eigen::Vector3d p = Eigen::Vector3d::Zero();
+        Eigen::Vector3d r = Eigen::Vector3d::Constant(0.1);
+        firi::maxVolInsEllipsoid(polys3[k], R, p, r, ws);
+
+        Eigen::Matrix2d R2 = Eigen::Matrix2d::Identity();
+        Eigen::Vector2d p2 = Eigen::Vector2d::Zero();
+        Eigen::Vector2d r2 = Eigen::Vector2d::Constant(0.1);
+        firi::maxVolInsEllipse(polys2[k], R2, p2, r2, ws);
+    }
+    counting = false;
+    return mallocs;
+}
+
+// once a workspace has seen the largest polytope, solving again in it
+// allocates nothing
+TEST(FIRIAlloc, repeatedSolveDoesNotAllocate){
+    std::vector<Eigen::MatrixX4d> polys3;
+    std::vector<Eigen::MatrixX3d> polys2;
+    randomPolytopes(polys3, polys2);
+
+    firi::MVIEWorkspace ws;
+    EXPECT_GT(solveAll(polys3, polys2, ws), 0);
+    EXPECT_EQ(solveAll(polys3, polys2, ws), 0);
+    EXPECT_EQ(solveAll(polys3, polys2, ws), 0);
+}
+
+// a workspace kept by the caller stays warm for threads that only live
+// for one call, like the workers of convexCover without a pool
+TEST(FIRIAlloc, workspaceOutlivesThreads){
+    std::vector<Eigen::MatrixX4d> polys3;
+    std::vector<Eigen::MatrixX3d> polys2;
+    randomPolytopes(polys3, polys2);
+
+    std::vector<firi::MVIEWorkspace> pool(2);
+    for(int call = 0; call < 3; call++){
+        long counts[2];
+        std::vector<std::thread> workers;
+        for(int w = 0; w < 2; w++)
+            workers.emplace_back([&, w](){ counts[w] = solveAll(polys3, polys2, pool[w]); });
+        for(std::thread& t : workers)
+            t.join();
+
+        for(int w = 0; w < 2; w++){
+            if (call == 0)
+                EXPECT_GT(counts[w], 0);
+            else
+                EXPECT_EQ(counts[w], 0) << "worker " << w << ", call " << call;
+        }
+    }
+}
+
+// obstacle points scattered over a 40m x 40m map, and a path through 
+// it that keeps clear of them
+static void randomCorridor(std::vector<Eigen::Vector3d>& points,
+                           std::vector<Eigen::Vector3d>& path){
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> u(0.0, 40.0);
+
+    path.clear();
+    for(int i = 0; i <= 8; i++)
+        path.push_back(Eigen::Vector3d(2.0 + 4.5*i, 20.0 + 6.0*std::sin(0.8*i), 0.0));
+
+    points.clear();
+    while (points.size() < 3000){
+        Eigen::Vector3d p(u(gen), u(gen), 0.0);
+
+        double clearance = INFINITY;
+        for(size_t i = 1; i < path.size(); i++){
+            Eigen::Vector3d d = path[i] - path[i-1];
+            double t = std::min(std::max((p - path[i-1]).dot(d) / d.squaredNorm(), 0.0), 1.0);
+            clearance = std::min(clearance, (path[i-1] + t*d - p).norm());
+        }
+        if (clearance > 0.5)
+            points.push_back(p);
+    }
+}
+
+// the corridor of the planner, in its workspace, cache and pool, returns 
+// the number of heap allocations of all threads
+static long coverOnce(const std::vector<Eigen::Vector3d>& path,
+                      const std::vector<Eigen::Vector3d>& points, bool planar,
+                      int threads, WorkerPool& pool, corridor::CorridorCache& cache, 
+                      corridor::CorridorWorkspace& cw, std::vector<Eigen::MatrixX4d>& hpolys){
+    allMallocs = 0;
+    countingAll = true;
+    bool ok = corridor::convexCover(path, points, Eigen::Vector3d(0, 0, -.1),
+                                    Eigen::Vector3d(40, 40, .1), 7.0, 5.0, hpolys,
+                                    1.0e-6, threads, planar, &cache, &cw, &pool);
+    countingAll = false;
+    EXPECT_TRUE(ok);
+    EXPECT_FALSE(hpolys.empty());
+    return allMallocs;
+}
+
+// replanning the same corridor allocates nothing once the workspace, the
+// cache (two corridors deep) and the output have seen it, with the 
+// workers in a pool started beforehand
+TEST(FIRIAlloc, repeatedCorridorDoesNotAllocate){
+    std::vector<Eigen::Vector3d> points, path;
+    randomCorridor(points, path);
+
+    WorkerPool pool;
+    pool.reserve(2);
+    for(int threads = 1; threads <= 2; threads++){
+        for(int planar = 0; planar < 2; planar++){
+            corridor::CorridorCache cache;
+            corridor::CorridorWorkspace cw;
+            std::vector<Eigen::MatrixX4d> hpolys;
+
+            EXPECT_GT(coverOnce(path, points, planar, threads, pool, cache, cw, hpolys), 0);
+            coverOnce(path, points, planar, threads, pool, cache, cw, hpolys);
+            for(int call = 2; call < 5; call++)
+                EXPECT_EQ(coverOnce(path, points, planar, threads, pool, cache, cw, hpolys), 0) 
+                    << "threads " << threads << ", planar " << planar << ", call " << call;
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}